@@ -157,28 +157,24 @@ normal
 
 : stack ( -- )
 
+	\ a native vector: vec-push grows it by doubling
 	record fields
 		cell field size
 		cell field data
+		cell field room
 	end
 
 	: last ( a -- b )
 		at! at size @ 1- 0 max cells at data @ + ;
 
-	: inc ( a -- )
-		at! 1 at size +! at data @ at size @ cells resize at data ! ;
-
-	: dec ( a -- )
-		size dup @ 1- 0 max swap ! ;
-
 	: push ( n a -- )
-		dup inc last ! ;
+		vec-push ;
 
 	: pop ( a -- n )
-		dup size @ if dup last @ swap dec else drop 0 end ;
+		vec-pop ;
 
 	: top ( a -- n )
-		dup size @ if last @ else drop 0 end ;
+		vec-top ;
 
 	: base ( a -- b )
 		data @ ;
@@ -187,15 +183,21 @@ normal
 		size @ ;
 
 	: get ( p a -- n )
-		at! 0 max at size @ 1- min cells at data @ + @ ;
+		vec-get ;
+
+	: append ( b n a -- )
+		vec-append ;
+
+	: truncate ( n a -- )
+		vec-truncate ;
 
 	: construct ( -- a )
-		fields allocate cell allocate over data ! ;
+		fields allocate dup vec-init ;
 
 	: destruct ( a -- )
-		dup data @ free free ;
+		dup vec-release free ;
 
-	create here fields allot cell allocate swap data ! does ;
+	create here fields allot vec-init does ;
 
 : list ( -- )
 
@@ -323,127 +325,46 @@ normal
 
 : dict ( chains -- )
 
+	\ a native hash map with string keys; chains only sizes it at first
 	record fields
-		cell field width
-		cell field chains
-	end
-
-	record node_fields
-		cell field name
-		cell field payload
+		cell field table
 	end
 
-	: chain ( n a -- c )
-		chains @ swap cells + ;
-
 	: length ( a -- n )
-		at! 0 at width @ for i at chain @ list:length + end ;
-
-	: hash ( name -- n )
-		at! 5381 begin c@+ my! my while 33 * my + end ;
-
-	: locate_node ( name list -- node )
-		list:first @ my! dup count 1+
-		begin my while over over
-			my list:payload @ name @ swap compare while
-			my list:post @ my!
-		end
-		drop drop my ;
+		table @ map-count ;
 
 	: insert ( payload name a -- )
-		at!
-		dup hash at width @ mod at chain @ my! ( payload name )
-		dup my locate_node dup
-		if
-			nip list:payload @ payload !
-		else
-			drop strdup
-			node_fields allocate
-			tuck name !
-			tuck payload !
-			my list:push
-		end ;
+		table @ map-set ;
 
 	: remove ( name a -- payload )
-		at!
-		dup hash at width @ mod at chain @ my! ( payload name )
-		my locate_node dup
-		if
-			my list:remove_node my!
-			my name @ free
-			my payload @
-			my free
-		end ;
+		table @ map-remove ;
 
 	: exists ( name a -- flag )
-		at!
-		dup hash at width @ mod at chain @ my! ( payload name )
-		my locate_node 0<> ;
+		table @ map-exists ;
 
 	: get ( name a -- payload )
-		at!
-		dup hash at width @ mod at chain @ my! ( payload name )
-		my locate_node dup
-		if
-			list:payload @ payload @
-		end ;
+		table @ map-get ;
 
 	: set ( payload name a -- )
-		insert ;
+		table @ map-set ;
+
+	\ xt ( name payload -- ), which must not change the dict
+	: each ( xt a -- )
+		table @ map-each ;
 
 	: dump ( a -- )
-		at!
-		at width @
-		for
-			i at chain @ list:first @
-			begin dup while
-				dup list:payload @
-				dup payload @ swap name @ "%s => %d\n" print
-				list:post @
-			end drop
-		end ;
+		: show ( name payload -- )
+			swap "%s => %d\n" print ;
+		'show swap each ;
 
 	: construct ( chains a -- )
-		at! dup at width ! dup cells allocate at chains !
-		for list:construct i at chain ! end ;
+		swap 0 map-new swap table ! ;
 
 	: destruct ( a -- )
-		at! at width @
-		for i at chain @ list:destruct end
-		at chains @ free ;
+		table @ map-free ;
 
 	create here fields allot construct does ;
 
-: sort ( xt a n -- )
-
-	static locals
-		0 value cmp
-	end
-
-	: mid ( l r -- mid )
-		over - 2/ cell neg and + ;
-
-	: exch ( a1 a2 -- )
-		dup @ push over @ swap ! pop swap ! ;
-
-	: part ( l r -- l r r2 l2 )
-		2dup mid @ push
-		2dup
-		begin
-			swap begin dup @ top  cmp execute while cell+ end
-			swap begin top over @ cmp execute while cell- end
-			2dup <= if 2dup exch push cell+ pop cell- end
-			2dup > until
-		end
-		pop drop ;
-
-	: qsort ( l r -- )
-		part swap rot
-		2dup < if qsort else 2drop end
-		2dup < if qsort else 2drop end ;
-
-	rot to cmp dup 1 > if 1- cells over + qsort else 2drop end ;
-
 : edit ( -- )
 
 	static locals
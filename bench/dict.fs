@@ -0,0 +1,122 @@
+\ Dictionary benchmark
+\
+\ Sets, gets and removes string keys in a DICT, the native hash map. With
+\ DICT=chained, the same runs on the list-chained dict base.fs used to
+\ have, kept below for comparison, at its usual fixed width.
+
+10000 value keys
+20    value rounds
+
+: chained ( chains -- )
+
+	record fields
+		cell field width
+		cell field chains
+	end
+
+	record node_fields
+		cell field name
+		cell field payload
+	end
+
+	: chain ( n a -- c )
+		chains @ swap cells + ;
+
+	: length ( a -- n )
+		at! 0 at width @ for i at chain @ list:length + end ;
+
+	: hash ( name -- n )
+		at! 5381 begin c@+ my! my while 33 * my + end ;
+
+	: locate_node ( name list -- node )
+		list:first @ my! dup count 1+
+		begin my while over over
+			my list:payload @ name @ swap compare while
+			my list:post @ my!
+		end
+		drop drop my ;
+
+	: insert ( payload name a -- )
+		at!
+		dup hash at width @ mod at chain @ my! ( payload name )
+		dup my locate_node dup
+		if
+			nip list:payload @ payload !
+		else
+			drop strdup
+			node_fields allocate
+			tuck name !
+			tuck payload !
+			my list:push
+		end ;
+
+	: remove ( name a -- payload )
+		at!
+		dup hash at width @ mod at chain @ my! ( payload name )
+		my locate_node dup
+		if
+			my list:remove_node my!
+			my name @ free
+			my payload @
+			my free
+		end ;
+
+	: exists ( name a -- flag )
+		at!
+		dup hash at width @ mod at chain @ my! ( payload name )
+		my locate_node 0<> ;
+
+	: get ( name a -- payload )
+		at!
+		dup hash at width @ mod at chain @ my! ( payload name )
+		my locate_node dup
+		if
+			list:payload @ payload @
+		end ;
+
+	: set ( payload name a -- )
+		insert ;
+
+	: dump ( a -- )
+		at!
+		at width @
+		for
+			i at chain @ list:first @
+			begin dup while
+				dup list:payload @
+				dup payload @ swap name @ "%s => %d\n" print
+				list:post @
+			end drop
+		end ;
+
+	: construct ( chains a -- )
+		at! dup at width ! dup cells allocate at chains !
+		for list:construct i at chain ! end ;
+
+	: destruct ( a -- )
+		at! at width @
+		for i at chain @ list:destruct end
+		at chains @ free ;
+
+	create here fields allot construct does ;
+
+"DICT" getenv "chained" 0 compare 0=
+if	"1024 chained table"
+else	"1024 dict table"
+end evaluate drop
+
+keys cells allocate value names
+
+: setup ( -- )
+	keys for i "key-%d" format strdup i cells names + ! end ;
+
+: run ( -- )
+	keys for i i cells names + @ table.set end
+	rounds for
+		keys for i cells names + @ table.get drop end
+	end
+	keys for i cells names + @ table.remove drop end ;
+
+setup run
+
+bye
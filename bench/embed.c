@@ -0,0 +1,65 @@
+// Embedded call latency benchmark
+//
+// Times rf_call() and rf_eval() on a warm VM against libreforth, with a
+// host primitive in the loop, to compare with starting reforth per rule.
+
+#include <stdio.h>
+#include <time.h>
+#include "../reforth.h"
+
+#define CALLS 100000
+
+static double
+now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// ( a b -- a+b )
+static void
+host_add(rf_vm *vm)
+{
+	long b = rf_pop(vm);
+	long a = rf_pop(vm);
+	rf_push(vm, a + b);
+}
+
+int
+main()
+{
+	rf_define("host+", host_add);
+
+	rf_vm *vm = rf_vm_new();
+	if (rf_eval(vm, ": rule ( n -- f ) dup 3 host+ swap 2 * > ;") != 0)
+		return 1;
+
+	double t = now();
+	long hits = 0;
+	for (int i = 0; i < CALLS; i++)
+	{
+		rf_push(vm, i % 5);
+		rf_call(vm, "rule");
+		hits += rf_pop(vm) != 0;
+	}
+	t = now() - t;
+	printf("rf_call: %.2f us/call (%ld hits)\n", t * 1e6 / CALLS, hits);
+
+	t = now();
+	for (int i = 0; i < CALLS / 10; i++)
+	{
+		rf_eval(vm, "4 rule");
+		rf_pop(vm);
+	}
+	t = now() - t;
+	printf("rf_eval: %.2f us/eval\n", t * 1e6 / (CALLS / 10));
+
+	// errors come back to the host rather than exiting
+	printf("unknown word: %d\n", rf_eval(vm, "no-such-word"));
+	printf("overflow: %d\n", rf_eval(vm, "1 1000000000 allot"));
+	printf("depth: %d\n", rf_depth(vm));
+
+	rf_vm_free(vm);
+	return 0;
+}
@@ -0,0 +1,25 @@
+#!/bin/bash
+# Measure the native web server with the bundled load generator.
+#
+# Usage: bench/load.sh [requests] [conns] [workers]
+#
+# Starts ./web on a spare port (with WORKERS forked processes if given)
+# and replays a mix of paths against it with ./webload. The summary goes
+# to stderr and one JSON line to stdout, for comparing runs.
+
+N=${1:-20000}
+CONNS=${2:-8}
+PORT=8092
+cd "$(dirname "$0")/.." || exit 1
+
+trap 'kill $server 2>/dev/null' EXIT
+
+if [ -n "$3" ]; then
+	PORT=$PORT WORKERS=$3 ./web 2>/dev/null &
+else
+	PORT=$PORT ./web 2>/dev/null &
+fi
+server=$!
+sleep 0.5
+
+PORT=$PORT CONNS=$CONNS REQUESTS=$N PATHS="/ /hello/reforth /missing" ./webload
@@ -0,0 +1,50 @@
+\ Heightmap smoothing benchmark
+\
+\ Box blurs a random 1024x1024 map, as rts.fs does, column by column. By
+\ default the columns run in a FOR loop on one core; SMOOTH=pfor runs them
+\ with PFOR over PFOR_WORKERS threads (default, one per core).
+
+1024 value width
+1024 value height
+4    value passes
+
+width height * allocate value map
+width height * allocate value out
+
+: tile ( x y -- a )
+	0 max height 1- min width *
+	swap 0 max width 1- min + map + ;
+
+: column ( -- )
+	i my!
+	height for 0
+		my 1- i 1- tile c@ +
+		my 1- i    tile c@ +
+		my 1- i 1+ tile c@ +
+		my    i 1- tile c@ +
+		my    i    tile c@ +
+		my    i 1+ tile c@ +
+		my 1+ i 1- tile c@ +
+		my 1+ i    tile c@ +
+		my 1+ i 1+ tile c@ +
+		9 / i width * my + out + c!
+	end ;
+
+: serial ( -- )
+	width for column end ;
+
+: parallel ( -- )
+	width 'column pfor ;
+
+: randomize ( -- )
+	map at!
+	width height * for 256 random c!+ end ;
+
+randomize
+
+"SMOOTH" getenv "pfor" 0 compare 0=
+if	passes for parallel out map width height * cmove end
+else	passes for serial   out map width height * cmove end
+end
+
+bye
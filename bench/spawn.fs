@@ -0,0 +1,18 @@
+\ Process spawn latency benchmark
+\
+\ Runs a trivial command many times through SYSTEM. By default the command
+\ has no shell syntax and is spawned directly; SPAWN=shell appends a ';'
+\ to force the /bin/sh -c path for comparison.
+
+1000 value runs
+
+: direct ( -- )
+	runs for null "true" system free end ;
+
+: shell ( -- )
+	runs for null "true;" system free end ;
+
+"SPAWN" getenv "shell" 0 compare 0=
+if shell else direct end
+
+bye
@@ -0,0 +1,42 @@
+#!/bin/bash
+# Compare the native web server with socat fork-per-connection.
+#
+# Usage: bench/web.sh [requests]
+#
+# Times a run of sequential GET requests against each setup. The native
+# server keeps the connection alive; socat pays a fork, an exec and a
+# base.fs + web.fs parse for every request.
+
+N=${1:-1000}
+PORT=8091
+cd "$(dirname "$0")/.." || exit 1
+
+config=$(mktemp)
+trap 'rm -f "$config"; kill $server 2>/dev/null' EXIT
+
+i=0
+while [ $i -lt "$N" ]; do
+	echo "url = \"http://127.0.0.1:$PORT/\""
+	echo "output = \"/dev/null\""
+	i=$((i+1))
+done >"$config"
+
+run() {
+	echo "$1: $N requests"
+	sleep 0.5
+	time curl -s -K "$config"
+	kill $server 2>/dev/null
+	wait $server 2>/dev/null
+}
+
+PORT=$PORT ./web 2>/dev/null &
+server=$!
+run native
+
+if command -v socat >/dev/null; then
+	socat TCP4-LISTEN:$PORT,reuseaddr,fork EXEC:./web 2>/dev/null &
+	server=$!
+	run socat
+else
+	echo "socat: not installed, skipped"
+fi
@@ -573,10 +573,7 @@ create input 100 allot
 		end
 		free
 
-		: cmp ( s1 s2 -- f )
-			dup count compare 0< ;
-
-		'cmp words.base words.depth sort
+		words.base words.depth sort-strings
 
 		here
 		words.depth
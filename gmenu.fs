@@ -69,26 +69,12 @@ create pattern 100 allot
 	match nip ;
 
 : readlines ( -- )
-	begin here at!
-		begin key my!
-			my while
-			my \n = until
-			my c!+
-		end
-		here at <
-		if
-			0 c!+
-			here at over - allocate
-			dup lines.push place
-		end
-		my while
-	end ;
-
-: cmp ( a b -- f )
-	dup count compare 0< ;
+	begin here 65536 read-line while
+		if here strdup lines.push end
+	end drop ;
 
 : sortlines ( -- )
-	'cmp lines.base lines.depth sort ;
+	lines.base lines.depth sort-strings ;
 
 : process ( -- )
 
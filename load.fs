@@ -0,0 +1,56 @@
+\ Reforth HTTP load generator
+\
+\	PORT=8080 CONNS=8 REQUESTS=10000 PATHS="/ /hello/x" ./webload
+\
+\ Sends GET requests for PATHS, round robin, over CONNS keep-alive
+\ connections to a server on this machine, then reports throughput and
+\ latency as text on stderr and as JSON on stdout.
+
+: env ( default name -- n )
+	getenv dup if nip number drop else drop end ;
+
+0 value stats
+
+: stat ( i -- n )
+	cells stats + @ ;
+
+8080  "PORT"     env value port
+8     "CONNS"    env value conns
+10000 "REQUESTS" env value requests
+
+"PATHS" getenv dup 0= if drop "/" end value paths
+
+paths conns requests port http-load to stats
+
+: completed ( -- n ) 0 stat ;
+: errors    ( -- n ) 1 stat ;
+: elapsed   ( -- n ) 2 stat 1 max ;
+: p50       ( -- n ) 3 stat ;
+: p90       ( -- n ) 4 stat ;
+: p99       ( -- n ) 5 stat ;
+: longest   ( -- n ) 6 stat ;
+: mean      ( -- n ) 7 stat ;
+
+\ responses per second
+: rate ( -- n )
+	completed 1000000 * elapsed / ;
+
+\ responses per log2 latency bucket
+: histogram ( -- )
+	32 for
+		i 8 + stat dup
+		if	1 i shl "    < %8d us  %d\n" format error
+		else	drop
+		end
+	end ;
+
+requests completed errors elapsed 1000 /
+"%d ms, %d errors, %d/%d completed\n" format error
+rate "%d req/sec\n" format error
+longest p99 p90 p50 mean
+"latency usec: mean %d p50 %d p90 %d p99 %d max %d\n" format error
+histogram
+
+longest p99 p90 p50 mean rate elapsed errors completed conns
+"{\"conns\":%d,\"completed\":%d,\"errors\":%d,\"elapsed_us\":%d,\"rps\":%d,\"mean_us\":%d,\"p50_us\":%d,\"p90_us\":%d,\"p99_us\":%d,\"max_us\":%d}\n"
+format type
@@ -35,9 +35,18 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
 #include <unistd.h>
 #include <poll.h>
 #include <time.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <pthread.h>
 
 #ifdef LIB_REGEX
 #include <regex.h>
@@ -45,6 +54,7 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #ifdef LIB_FORK
 #include <sys/wait.h>
+#include <spawn.h>
 #endif
 
 #ifdef LIB_SHELL
@@ -52,12 +62,17 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <sys/ioctl.h>
 #endif
 
-/*
+#ifdef EMBED
+#include <setjmp.h>
+#include "reforth.h"
+#endif
+
 #ifdef LIB_SERVE
 #include <sys/socket.h>
+#include <sys/epoll.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #endif
-*/
 
 // Execution Token
 typedef int16_t tok;
@@ -80,8 +95,15 @@ typedef struct _word {
 #define MAXTOKEN 4096
 #define CODESPACE 1024*1024
 
+#ifdef EMBED
+// Embedded, a failed check abandons the host's current call (see rf_run)
+// rather than exiting the host process
+__thread jmp_buf *rf_fail;
+#define ensure(x) for ( ; !(x) ; rf_fail ? longjmp(*rf_fail, 1): exit(EXIT_FAILURE) )
+#else
 #define ensure(x) for ( ; !(x) ; exit(EXIT_FAILURE) )
-#define errorf(...) do { fprintf(stderr, __VA_ARGS__); fputc('\n', stderr); } while(0)
+#endif
+void errorf(const char *fmt, ...);
 
 enum {
 	// codewords
@@ -93,6 +115,10 @@ enum {
 	MOD, AND, OR, XOR, LESS, MORE, EQUAL, NEQUAL, ZEQUAL, ZLESS, ZMORE, MAX,
 	MIN, ADD1, SUB1, SHL1, SHR1, EXECUTE, MOVE, CMOVE, NUMBER, MACRO, NORMAL,
 	VALUE, VARY, CREATE, EMIT, KEY, KEYQ, ALLOCATE, RESIZE, FREE, FORMAT,
+	VEC_INIT, VEC_RELEASE, VEC_PUSH, VEC_POP, VEC_TOP, VEC_GET, VEC_FETCH,
+	VEC_STORE, VEC_APPEND, VEC_TRUNCATE, MAP_NEW, MAP_FREE, MAP_SET, MAP_GET,
+	MAP_EXISTS, MAP_REMOVE, MAP_COUNT, MAP_EACH, SORT, MSORT, SORT_CELLS,
+	SORT_STRINGS,
 	DEPTH, HERE, ALLOT, COMMA, CCOMMA, CELLS, BYTES, ZNE, PLACE, PICK, ABS,
 	SMOD, TYPE, EVALUATE, COUNT, COMPARE, GETENV, PUTENV, SLURP, BLURT, CORE,
 	SYS, COLON, SCOLON, IF, ELSE, FOR, BEGIN, END, COM1, COM2, RECORD, FIELD,
@@ -101,7 +127,15 @@ enum {
 	XT_HEAD, XT_NAME, XT_CODE, XT_BODY, XT_LIST, XT_LINK, PARSE, SPARSE, FIND,
 	FINDPAIR, COMPILE, NCOMPILE, SCOMPILE, MODE, LABEL, REDOES, ONOK, ONWHAT,
 	ONERROR, ONEVAL, SOURCE, ERROR, USEC, STATIC, RANDOM, TIME, DATE,
-	FILL, CFILL, USED, UNUSED, INV,
+	FILL, CFILL, USED, UNUSED, INV, FLUSH, LINE_OUTPUT, READ_LINE,
+	READ_BYTES, MAPFILE, UNMAPFILE, OPEN_FILE, CLOSE_FILE, READ_FILE,
+	READ_FILE_LINE, WRITE_FILE, SEEK_FILE, FILE_SIZE, BLURT_ATOMIC, TYPE_HTML,
+	LOG_LINE, LOG_LEVEL, LOG_FLUSH, THREAD, THREAD_JOIN, PFOR, PREDUCE, PFOR_WORK, TASK, YIELD, RESUME, JOIN, TASK_END,
+#ifdef TASK_BUDGET
+	TASK_BUDGET_W,
+#endif
+	SEND_FILE, PARSE_REQUEST, REQ_METHOD, REQ_PATH, REQ_QUERY, REQ_VERSION,
+	REQ_BODY, REQ_HEADER, ROUTE, DISPATCH, ROUTE_PARAM,
 
 	OPT_DUP_SAT, OPT_DUP_SMY, OPT_DUP_WHILE, OPT_DUP_UNTIL, OPT_DUP_BRANCH,
 	OPT_IDX_ADD, OPT_LIT_NUM_ADD,
@@ -118,8 +152,18 @@ enum {
 	MATCH, SPLIT,
 #endif
 
+#ifdef LIB_SERVE
+	SERVE, SERVE_PREFORK, CACHE_PAGE, CACHE_VARY, CACHE_STATS, HTTP_LOAD,
+#endif
+
+#ifdef EMBED
+	HOST,
+#endif
+
 #ifdef LIB_FORK
-	FORK, SELF, SYSTEM,
+	FORK, SELF, SYSTEM, SYSTEM_STREAM, SPAWN, WAIT_PID, COPROC, COPROC_SEND,
+	COPROC_RECV_LINE, COPROC_ASK, COPROC_CLOSE, SYSTEM_ALL, FORK_MAP,
+	SHM_ALLOCATE, SHM_FREE,
 #endif
 
 	NOP, LASTTOKEN
@@ -203,9 +247,33 @@ wordinit list_normals[] = {
 	{ .token = EMIT,     .name = "emit"     },
 	{ .token = KEY,      .name = "key"      },
 	{ .token = KEYQ,     .name = "key?"     },
+	{ .token = READ_LINE,  .name = "read-line"  },
+	{ .token = READ_BYTES, .name = "read-bytes" },
 	{ .token = ALLOCATE, .name = "allocate" },
 	{ .token = RESIZE,   .name = "resize"   },
 	{ .token = FREE,     .name = "free"     },
+	{ .token = VEC_INIT,     .name = "vec-init"     },
+	{ .token = VEC_RELEASE,  .name = "vec-release"  },
+	{ .token = VEC_PUSH,     .name = "vec-push"     },
+	{ .token = VEC_POP,      .name = "vec-pop"      },
+	{ .token = VEC_TOP,      .name = "vec-top"      },
+	{ .token = VEC_GET,      .name = "vec-get"      },
+	{ .token = VEC_FETCH,    .name = "vec@"         },
+	{ .token = VEC_STORE,    .name = "vec!"         },
+	{ .token = VEC_APPEND,   .name = "vec-append"   },
+	{ .token = VEC_TRUNCATE, .name = "vec-truncate" },
+	{ .token = MAP_NEW,      .name = "map-new"      },
+	{ .token = MAP_FREE,     .name = "map-free"     },
+	{ .token = MAP_SET,      .name = "map-set"      },
+	{ .token = MAP_GET,      .name = "map-get"      },
+	{ .token = MAP_EXISTS,   .name = "map-exists"   },
+	{ .token = MAP_REMOVE,   .name = "map-remove"   },
+	{ .token = MAP_COUNT,    .name = "map-count"    },
+	{ .token = MAP_EACH,     .name = "map-each"     },
+	{ .token = SORT,         .name = "sort"         },
+	{ .token = MSORT,        .name = "msort"        },
+	{ .token = SORT_CELLS,   .name = "sort-cells"   },
+	{ .token = SORT_STRINGS, .name = "sort-strings" },
 	{ .token = FORMAT,   .name = "format"   },
 	{ .token = DEPTH,    .name = "depth"    },
 	{ .token = HERE,     .name = "here"     },
@@ -218,6 +286,41 @@ wordinit list_normals[] = {
 	{ .token = PUTENV,   .name = "putenv"   },
 	{ .token = SLURP,    .name = "slurp"    },
 	{ .token = BLURT,    .name = "blurt"    },
+	{ .token = MAPFILE,   .name = "map-file"   },
+	{ .token = UNMAPFILE, .name = "unmap-file" },
+	{ .token = BLURT_ATOMIC, .name = "blurt-atomic" },
+	{ .token = THREAD,     .name = "thread"     },
+	{ .token = THREAD_JOIN, .name = "thread-join" },
+	{ .token = PFOR,       .name = "pfor"       },
+	{ .token = PREDUCE,    .name = "preduce"    },
+	{ .token = TASK,       .name = "task"       },
+	{ .token = YIELD,      .name = "yield"      },
+	{ .token = RESUME,     .name = "resume"     },
+	{ .token = JOIN,       .name = "join"       },
+#ifdef TASK_BUDGET
+	{ .token = TASK_BUDGET_W, .name = "task-budget" },
+#endif
+	{ .token = LOG_LINE,   .name = "log-line"   },
+	{ .token = LOG_LEVEL,  .name = "log-level"  },
+	{ .token = LOG_FLUSH,  .name = "log-flush"  },
+	{ .token = SEND_FILE,  .name = "send-file"  },
+	{ .token = PARSE_REQUEST, .name = "parse-request" },
+	{ .token = REQ_METHOD,  .name = "req-method"  },
+	{ .token = REQ_PATH,    .name = "req-path"    },
+	{ .token = REQ_QUERY,   .name = "req-query"   },
+	{ .token = REQ_VERSION, .name = "req-version" },
+	{ .token = REQ_BODY,    .name = "req-body"    },
+	{ .token = REQ_HEADER,  .name = "req-header"  },
+	{ .token = ROUTE,       .name = "route"       },
+	{ .token = DISPATCH,    .name = "dispatch"    },
+	{ .token = ROUTE_PARAM, .name = "route-param" },
+	{ .token = OPEN_FILE,  .name = "open-file"  },
+	{ .token = CLOSE_FILE, .name = "close-file" },
+	{ .token = READ_FILE,  .name = "read-file"  },
+	{ .token = READ_FILE_LINE, .name = "read-file-line" },
+	{ .token = WRITE_FILE, .name = "write-file" },
+	{ .token = SEEK_FILE,  .name = "seek-file"  },
+	{ .token = FILE_SIZE,  .name = "file-size"  },
 	{ .token = NOP,      .name = "nop"      },
 	{ .token = COMMA,    .name = ","        },
 	{ .token = CCOMMA,   .name = "c,"       },
@@ -229,6 +332,7 @@ wordinit list_normals[] = {
 	{ .token = SMOD,     .name = "/mod"     },
 	{ .token = PICK,     .name = "pick"     },
 	{ .token = TYPE,     .name = "type"     },
+	{ .token = TYPE_HTML, .name = "type-html" },
 	{ .token = ERROR,    .name = "error"    },
 	{ .token = USEC,     .name = "usec"     },
 	{ .token = FIELD,    .name = "field"    },
@@ -238,6 +342,7 @@ wordinit list_normals[] = {
 	{ .token = DATE,     .name = "date"     },
 	{ .token = FILL,     .name = "fill"     },
 	{ .token = CFILL,    .name = "cfill"    },
+	{ .token = FLUSH,    .name = "flush"    },
 
 #ifdef DEBUG
 	{ .token = SLOW,     .name = "slow"     },
@@ -254,10 +359,31 @@ wordinit list_normals[] = {
 	{ .token = SPLIT,    .name = "split"    },
 #endif
 
+#ifdef LIB_SERVE
+	{ .token = SERVE,    .name = "serve"    },
+	{ .token = SERVE_PREFORK, .name = "serve-prefork" },
+	{ .token = CACHE_PAGE, .name = "cache-page" },
+	{ .token = CACHE_VARY, .name = "cache-vary" },
+	{ .token = CACHE_STATS, .name = "cache-stats" },
+	{ .token = HTTP_LOAD,   .name = "http-load"   },
+#endif
+
 #ifdef LIB_FORK
 	{ .token = FORK,     .name = "fork"     },
+	{ .token = FORK_MAP, .name = "fork-map" },
+	{ .token = SHM_ALLOCATE, .name = "shm-allocate" },
+	{ .token = SHM_FREE,     .name = "shm-free"     },
 	{ .token = SELF,     .name = "self"     },
 	{ .token = SYSTEM,   .name = "system"   },
+	{ .token = SYSTEM_STREAM, .name = "system-stream" },
+	{ .token = SYSTEM_ALL,    .name = "system-all"    },
+	{ .token = SPAWN,    .name = "spawn"    },
+	{ .token = WAIT_PID, .name = "wait-pid" },
+	{ .token = COPROC,       .name = "coproc"       },
+	{ .token = COPROC_SEND,  .name = "coproc-send"  },
+	{ .token = COPROC_RECV_LINE, .name = "coproc-recv-line" },
+	{ .token = COPROC_ASK,   .name = "coproc-ask"   },
+	{ .token = COPROC_CLOSE, .name = "coproc-close" },
 #endif
 
 };
@@ -288,6 +414,11 @@ wordinit list_hiddens[] = {
 	{ .token = LIT_TOK,  .name = "lit_tok"  },
 	{ .token = LIT_NUM,  .name = "lit_num"  },
 	{ .token = LIT_STR,  .name = "lit_str"  },
+	{ .token = TASK_END, .name = "task_end" },
+	{ .token = PFOR_WORK, .name = "pfor_work" },
+#ifdef EMBED
+	{ .token = HOST,     .name = "host"     },
+#endif
 	{ .token = BRANCH,   .name = "branch"   },
 	{ .token = JUMP,     .name = "jump"     },
 	{ .token = LOOP,     .name = "loop"     },
@@ -318,6 +449,7 @@ wordinit list_hiddens[] = {
 	{ .token = ONEVAL,   .name = "on-eval"  },
 	{ .token = ONERROR,  .name = "on-error" },
 	{ .token = SOURCE,   .name = "source"   },
+	{ .token = LINE_OUTPUT, .name = "line-output" },
 
 	{ .token = UNBUFFERED, .name = "unbuffered" },
 	{ .token = BUFFERED,   .name = "buffered"   },
@@ -333,7 +465,9 @@ wordinit list_hiddens[] = {
 };
 
 // Some Forth global variables
-cell source, mode, on_ok, on_error, on_what, on_eval;
+// Interpreter state is per thread (see THREAD); the dictionary is shared
+__thread cell source, mode;
+cell on_ok, on_error, on_what, on_eval;
 word *macro, *normal, **current;
 
 // Code space
@@ -360,43 +494,88 @@ tok *body[MAXTOKEN];
 char*
 slurp(char *name)
 {
-	int len = 0, lim = 1024;
-	char *pad = malloc(lim+1);
+	int fd = open(name, O_RDONLY);
+	if (fd < 0) return NULL;
 
-	FILE *file = fopen(name, "r");
-	if (!file) return NULL;
+	// regular files are read in one go; anything else grows as it arrives
+	struct stat st;
+	size_t size = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) ? st.st_size: 0;
+	size_t len = 0, lim = size ? size: 1024;
+	char *pad = malloc(lim+1);
 
-	unsigned int read = 0;
 	for (;;)
 	{
-		read = fread(pad+len, 1, 1024, file);
-		len += read; lim += 1024; pad[len] = 0;
-		if (read < 1024) break;
-		pad = realloc(pad, lim+1);
+		if (len > lim)
+		{
+			lim *= 2;
+			pad = realloc(pad, lim+1);
+		}
+		ssize_t rc = read(fd, pad+len, lim+1-len);
+		if (rc < 1) break;
+		len += rc;
+		if (size && len == size) break;
 	}
 	pad[len] = 0;
-	fclose(file);
+	close(fd);
 	return pad;
 }
 
-// Write a file to disk
-int
-blurt(const char *name, char *data, unsigned int dlen)
+// Map a file into memory copy-on-write, so it may be modified in place
+// (eg, by SPLIT) without touching the file. The mapping is followed by at
+// least one zero byte, so the contents may be treated as a string.
+char*
+map_file(char *name, cell *len)
 {
-	FILE *f = fopen(name, "w+");
-	if (!f || fwrite(data, 1, dlen, f) != dlen) return 0;
-	fclose(f);
-	return 1;
+	*len = 0;
+	int fd = open(name, O_RDONLY);
+	if (fd < 0) return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		close(fd);
+		return NULL;
+	}
+
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t size = st.st_size;
+
+	// reserve the span plus a trailing zero page, then map the file over it
+	char *map = mmap(NULL, (size / page + 1) * page, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (map != MAP_FAILED && size && mmap(map, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_FIXED, fd, 0) == MAP_FAILED)
+	{
+		munmap(map, (size / page + 1) * page);
+		map = MAP_FAILED;
+	}
+	close(fd);
+
+	if (map == MAP_FAILED)
+		return NULL;
+
+	*len = size;
+	return map;
+}
+
+void
+unmap_file(char *map, cell len)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	if (map) munmap(map, (len / page + 1) * page);
 }
 
-tok *compile_last;
-tok *ncompile_last;
+__thread tok *compile_last;
+__thread tok *ncompile_last;
+
+// Set in OS threads, which share the dictionary with the main thread
+__thread int dict_locked;
+#define dict_check() ensure(!dict_locked) errorf("thread: dictionary is read-only")
 
 // Compile an execution token to code space
 void
 compile(tok n, tok **p)
 {
 	tok *cp = *p;
+	dict_check();
 	ensure(cp + sizeof(tok) < code + CODESPACE)
 		errorf("dictionary overflow");
 	if (compile_last == cp-1)
@@ -484,6 +663,7 @@ void
 ncompile(cell n, tok **p)
 {
 	tok *cp = *p;
+	dict_check();
 	ensure(cp + sizeof(cell) < code + CODESPACE)
 		errorf("dictionary overflow");
 	ncompile_last = cp;
@@ -498,6 +678,7 @@ void
 scompile(char *s, tok **p)
 {
 	tok *cp = *p;
+	dict_check();
 	ensure(cp + strlen(s) + 1 < code + CODESPACE)
 		errorf("dictionary overflow");
 	// reserve byte for count
@@ -530,7 +711,7 @@ patch(tok *tokp, tok **p)
 	*tokp = (char*)cp - (char*)tokp;
 }
 
-char parsed[1024];
+__thread char parsed[1024];
 
 // Parse a white-space delimited word from source
 char*
@@ -545,10 +726,10 @@ parse()
 	return len ? parsed: NULL;
 }
 
-int sparse_i;
+__thread int sparse_i;
 #define SPARSE_BUF 1024*1
 #define SPARSE_BUFS 3
-char *sparse_bufs[SPARSE_BUFS];
+__thread char *sparse_bufs[SPARSE_BUFS];
 
 // Parse a quote delimited string literal from source
 char*
@@ -607,6 +788,7 @@ sparse()
 tok
 label(word **p)
 {
+	dict_check();
 	word *hp = *p;
 	parse();
 	word *w = hp++;
@@ -620,25 +802,20 @@ label(word **p)
 	return w-head;
 }
 
-int format_i;
+__thread int format_i;
 #define FORMAT_BUF 1024*64
 #define FORMAT_BUFS 3
-char *format_bufs[FORMAT_BUFS];
+__thread char *format_bufs[FORMAT_BUFS];
 
 // Format a string using C-like printf() syntax
-char*
-format(char *in, cell **_dsp)
+int
+format_to(char *buf, int lim, char *in, cell **_dsp)
 {
 	cell *dsp = *_dsp;
-	char *buf = malloc(FORMAT_BUF);
-
-	int idx = format_i++;
-	if (format_i == FORMAT_BUFS) format_i = 0;
-
 	char tmp[32], *p;
 	int len = 0;
 
-	while (*in && len < FORMAT_BUF-2)
+	while (*in && len < lim-2)
 	{
 		char c = *in++;
 		if (*in && c == '%')
@@ -655,27 +832,59 @@ format(char *in, cell **_dsp)
 
 				if (c == 's')
 				{
-					len += snprintf(buf+len, FORMAT_BUF-len, tmp, (char*)dpop);
+					len += snprintf(buf+len, lim-len, tmp, (char*)dpop);
 				}
 				else
 				if (strchr("cdiouxX", c))
 				{
-					len += snprintf(buf+len, FORMAT_BUF-len, tmp, dpop);
+					len += snprintf(buf+len, lim-len, tmp, dpop);
 				}
 				else
 				if (strchr("eEfgG", c))
 				{
-					len += snprintf(buf+len, FORMAT_BUF-len, tmp, (double)dpop);
+					len += snprintf(buf+len, lim-len, tmp, (double)dpop);
 				}
+				if (len > lim-1)
+					len = lim-1;
 				continue;
 			}
 		}
 		buf[len++] = c;
 	}
 	buf[len] = 0;
+	*_dsp = dsp;
+	return len;
+}
+
+// Count the stack items a format pattern consumes
+int
+format_args(char *in)
+{
+	int n = 0;
+	while ((in = strchr(in, '%')))
+	{
+		if (in[1] == '%')
+			in += 2;
+		else
+		{
+			n += in[1] != 0;
+			in++;
+		}
+	}
+	return n;
+}
+
+char*
+format(char *in, cell **_dsp)
+{
+	char *buf = malloc(FORMAT_BUF);
+
+	int idx = format_i++;
+	if (format_i == FORMAT_BUFS) format_i = 0;
+
+	format_to(buf, FORMAT_BUF, in, _dsp);
 	free(format_bufs[idx]);
 	format_bufs[idx] = buf;
-	*_dsp = dsp;
 	return buf;
 }
 
@@ -822,8 +1031,242 @@ number(char *conv, cell *res)
 	return 0;
 }
 
-FILE *stdin_current;
-FILE *stdout_current;
+__thread FILE *stdin_current;
+__thread FILE *stdout_current;
+
+// Output is collected in user space and written in large chunks, rather
+// than a write() per TYPE or EMIT. Buffers are flushed explicitly, when
+// full, before anything that blocks or hands the terminal to someone
+// else (KEY, SYSTEM, FORK, BYE), and on newline when in line mode.
+#define OUTPUT_BUF 1024*64
+
+typedef struct {
+	int fd, len;
+	cell lines;
+	// the reader is a child that may have gone; see write_quiet
+	int quiet;
+	// with no fd, output is captured here instead
+	char *mem;
+	size_t mlen, mlim;
+	char buf[OUTPUT_BUF];
+} output;
+
+__thread output out_std, out_err, *out_current;
+
+// Write a whole buffer, retrying short writes
+int
+write_all(int fd, const char *data, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t rc = write(fd, data, len);
+		if (rc < 1)
+			return 0;
+		data += rc;
+		len -= rc;
+	}
+	return 1;
+}
+
+// A child's pipe or a client's socket may lose its reader at any time.
+// SIGPIPE is blocked in this thread around writes to one, and any it
+// raised is discarded, so that shows up as a failed write (EPIPE) while
+// the process keeps its own SIGPIPE disposition for stdout.
+void
+sigpipe_block(sigset_t *old)
+{
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &set, old);
+}
+
+void
+sigpipe_unblock(sigset_t *old)
+{
+	sigset_t set;
+	struct timespec now = { 0, 0 };
+	sigpending(&set);
+	if (sigismember(&set, SIGPIPE) && !sigismember(old, SIGPIPE))
+	{
+		sigemptyset(&set);
+		sigaddset(&set, SIGPIPE);
+		sigtimedwait(&set, NULL, &now);
+	}
+	pthread_sigmask(SIG_SETMASK, old, NULL);
+}
+
+int
+write_quiet(int fd, const char *data, size_t len)
+{
+	sigset_t old;
+	sigpipe_block(&old);
+	int ok = write_all(fd, data, len);
+	sigpipe_unblock(&old);
+	return ok;
+}
+
+// Send bytes on to an output's file descriptor, or its capture memory
+int
+out_sink(output *o, const char *data, size_t len)
+{
+	if (o->fd >= 0)
+		return o->quiet ? write_quiet(o->fd, data, len): write_all(o->fd, data, len);
+	if (o->mlen + len > o->mlim)
+	{
+		o->mlim = (o->mlen + len) * 2;
+		o->mem = realloc(o->mem, o->mlim);
+	}
+	memcpy(o->mem + o->mlen, data, len);
+	o->mlen += len;
+	return 1;
+}
+
+int
+out_flush(output *o)
+{
+	int ok = o->len ? out_sink(o, o->buf, o->len): 1;
+	o->len = 0;
+	return ok;
+}
+
+// Logging. Lines are formatted straight into a buffer behind a
+// timestamp that is rebuilt at most once a second, and go to stderr,
+// along with anything already buffered there, in one writev. That
+// happens when the buffer fills, a second has passed since the last
+// flush, or output is flushed anyway (idle server, exit, fork). Lines
+// above LOG-LEVEL are dropped without being formatted.
+
+#define LOG_BUF 1024*64
+#define LOG_LINE_MAX 1024*4
+
+__thread struct {
+	cell level;
+	time_t stamp, flushed;
+	char when[64];
+	size_t wlen, len;
+	char buf[LOG_BUF];
+} logs = { .level = 2 };
+
+void
+log_flush()
+{
+	if (!logs.len)
+		return;
+	struct iovec iov[2] = {
+		{ .iov_base = out_err.buf, .iov_len = out_err.len },
+		{ .iov_base = logs.buf, .iov_len = logs.len },
+	};
+	ssize_t rc = out_err.fd < 0 ? -1: writev(out_err.fd, iov, 2);
+	size_t done = rc > 0 ? rc: 0;
+	if (done < iov[0].iov_len)
+	{
+		out_sink(&out_err, out_err.buf + done, out_err.len - done);
+		done = out_err.len;
+	}
+	if (done < out_err.len + logs.len)
+		out_sink(&out_err, logs.buf + done - out_err.len, out_err.len + logs.len - done);
+	out_err.len = 0;
+	logs.len = 0;
+	logs.flushed = logs.stamp;
+}
+
+// Log a formatted line at a level; args are consumed either way
+void
+log_line(char *pattern, cell level, cell **_dsp)
+{
+	char line[LOG_LINE_MAX];
+	time_t now;
+
+	if (level > logs.level)
+	{
+		*_dsp -= format_args(pattern);
+		return;
+	}
+
+	if ((now = time(NULL)) != logs.stamp)
+	{
+		logs.stamp = now;
+		logs.wlen = strftime(logs.when, sizeof(logs.when), "%c ", localtime(&now));
+	}
+
+	int len = format_to(line, LOG_LINE_MAX-1, pattern, _dsp);
+	line[len++] = '\n';
+
+	if (logs.len + logs.wlen + len > LOG_BUF)
+		log_flush();
+	memcpy(logs.buf + logs.len, logs.when, logs.wlen);
+	memcpy(logs.buf + logs.len + logs.wlen, line, len);
+	logs.len += logs.wlen + len;
+
+	if (now != logs.flushed)
+		log_flush();
+}
+
+void
+out_flush_all()
+{
+	out_flush(&out_std);
+	out_flush(&out_err);
+	log_flush();
+}
+
+// Report an error line on stderr, after anything already buffered there
+void
+errorf(const char *fmt, ...)
+{
+	char line[LOG_LINE_MAX];
+	va_list args;
+	va_start(args, fmt);
+	int len = vsnprintf(line, LOG_LINE_MAX-1, fmt, args);
+	va_end(args);
+	len = len < 0 ? 0: len > LOG_LINE_MAX-2 ? LOG_LINE_MAX-2: len;
+	line[len++] = '\n';
+	log_flush();
+	out_flush(&out_err);
+	out_sink(&out_err, line, len);
+}
+
+int
+out_write(output *o, const char *data, size_t len)
+{
+	if (o->len + len > OUTPUT_BUF)
+	{
+		if (!out_flush(o))
+			return 0;
+		if (len > OUTPUT_BUF)
+			return out_sink(o, data, len);
+	}
+	memcpy(o->buf + o->len, data, len);
+	o->len += len;
+	if (o->lines && memchr(data, '\n', len))
+		return out_flush(o);
+	return 1;
+}
+
+// Write a string with HTML special characters escaped
+int
+out_html(output *o, char *s)
+{
+	int ok = 1;
+	while (*s && ok)
+	{
+		size_t run = strcspn(s, "&<>\"'");
+		ok = out_write(o, s, run);
+		s += run;
+		switch (*s)
+		{
+			case '&':  ok = ok && out_write(o, "&amp;",  5); break;
+			case '<':  ok = ok && out_write(o, "&lt;",   4); break;
+			case '>':  ok = ok && out_write(o, "&gt;",   4); break;
+			case '"':  ok = ok && out_write(o, "&quot;", 6); break;
+			case '\'': ok = ok && out_write(o, "&#39;",  5); break;
+			default: continue;
+		}
+		s++;
+	}
+	return ok;
+}
 
 #ifdef LIB_SHELL
 
@@ -835,8 +1278,8 @@ at_xy(int x, int y)
 	x++; y++;
 
 	char tmp[32];
-	sprintf(tmp, "\e[%d;%dH", y, x);
-	write(fileno(stdout_current), tmp, strlen(tmp));
+	int len = sprintf(tmp, "\e[%d;%dH", y, x);
+	out_write(out_current, tmp, len);
 }
 
 void
@@ -850,14 +1293,113 @@ max_xy(int *x, int *y)
 
 #endif
 
+// Input is read in large chunks and handed out from user space, rather
+// than a read() per KEY. The terminal gets its own buffer so bytes already
+// read from a redirected stdin survive a switch to sys:pseudo-terminal.
+#define INPUT_BUF 1024*64
+
+typedef struct {
+	int fd, pos, len, tied;
+	char buf[INPUT_BUF];
+} input;
+
+__thread input in_std, in_tty, *in_current;
+
+// Make sure an input buffer has data; returns bytes available
+int
+in_fill(input *in)
+{
+	if (in->pos < in->len)
+		return in->len - in->pos;
+	if (in->tied)
+		out_flush_all();
+	int rc = read(in->fd, in->buf, INPUT_BUF);
+	in->pos = 0;
+	in->len = rc > 0 ? rc: 0;
+	return in->len;
+}
+
+// Read a line, keeping up to lim-1 bytes of it without the line
+// terminator. The rest of a longer line is dropped, as the terminator
+// of one that exactly fills the buffer must be, or it reads as an
+// empty line next time
+int
+in_line(input *in, char *buf, cell lim, cell *len)
+{
+	int got = 0, ended = 0;
+	cell n = 0;
+	while (n < lim-1 && in_fill(in))
+	{
+		char *s = in->buf + in->pos;
+		cell take = in->len - in->pos;
+		if (take > lim-1-n)
+			take = lim-1-n;
+		char *nl = memchr(s, '\n', take);
+		if (nl)
+			take = nl - s;
+		memcpy(buf+n, s, take);
+		n += take;
+		in->pos += take;
+		got = 1;
+		if (nl)
+		{
+			in->pos++;
+			ended = 1;
+			break;
+		}
+	}
+	while (!ended && in_fill(in))
+	{
+		char *s = in->buf + in->pos;
+		char *nl = memchr(s, '\n', in->len - in->pos);
+		in->pos = nl ? nl - in->buf + 1: in->len;
+		ended = nl != NULL;
+		got = 1;
+	}
+	if (n && buf[n-1] == '\r')
+		n--;
+	if (lim > 0)
+		buf[n] = 0;
+	*len = n;
+	return got ? -1:0;
+}
+
+// Read up to len bytes, returning short only at end of file
+cell
+in_bytes(input *in, char *buf, cell len)
+{
+	cell n = 0;
+	while (n < len)
+	{
+		cell take = in->len - in->pos;
+		if (!take && len-n >= INPUT_BUF)
+		{
+			// large reads bypass the buffer
+			if (in->tied)
+				out_flush_all();
+			take = read(in->fd, buf+n, len-n);
+			if (take < 1)
+				break;
+			n += take;
+			continue;
+		}
+		if (!(take = in_fill(in)))
+			break;
+		if (take > len-n)
+			take = len-n;
+		memcpy(buf+n, in->buf + in->pos, take);
+		in->pos += take;
+		n += take;
+	}
+	return n;
+}
+
 int
 key()
 {
 #ifdef LIB_SHELL
-	char c = 0;
-	int bytes = read(fileno(stdin_current), &c, 1);
-	if (bytes < 1) c = 0;
-	return c;
+	input *in = in_current;
+	return in_fill(in) ? in->buf[in->pos++]: 0;
 #else
 	return 0;
 #endif
@@ -867,8 +1409,11 @@ int
 keyq()
 {
 #ifdef LIB_SHELL
+	if (in_current->pos < in_current->len)
+		return -1;
+	out_flush_all();
 	struct pollfd fds;
-	fds.fd = fileno(stdin_current);
+	fds.fd = in_current->fd;
 	fds.events = POLLIN;
 	fds.revents = 0;
 	return poll(&fds, 1, 0) > 0 ? -1:0;
@@ -877,177 +1422,3086 @@ keyq()
 #endif
 }
 
-#ifdef LIB_REGEX
-
-#define REGEX_CACHE 4
-char *re_patterns[REGEX_CACHE];
-regex_t re_compiled[REGEX_CACHE];
+// Buffered file handle, for streaming files too large to SLURP
+typedef struct {
+	input in;
+	output out;
+} file;
 
-regex_t*
-regex(char *pattern)
+file*
+file_fd(int fd)
 {
-	regex_t *re = NULL; int i;
-
-	// have we compiled this regex before?
-	for (i = 0; i < REGEX_CACHE; i++)
-	{
-		if (re_patterns[i] && same_name(pattern, re_patterns[i]))
-		{
-			re = &re_compiled[i];
-			break;
-		}
-	}
-	if (!re)
-	{
-		// look for a free cache slot
-		for (i = 0; i < REGEX_CACHE; i++)
-		{
-			if (!re_patterns[i])
-				break;
-		}
-		if (i == REGEX_CACHE)
-		{
-			// free the oldest
-			i = REGEX_CACHE - 1;
-			regfree(&re_compiled[0]); free(re_patterns[0]);
-			memmove(&re_compiled[0], &re_compiled[1], sizeof(regex_t) * i);
-			memmove(&re_patterns[0], &re_patterns[1], sizeof(char*)   * i);
-		}
-		re = &re_compiled[i];
-		re_patterns[i] = strdup(pattern);
-		if (regcomp(re, pattern, REG_EXTENDED) != 0)
-		{
-			re = NULL;
-			re_patterns[i] = NULL;
-		}
-	}
-	return re;
+	file *f = calloc(1, sizeof(file));
+	f->in.fd = fd;
+	f->out.fd = fd;
+	return f;
 }
 
-// POSIX regex match
-int
-match(char *pattern, char **subject)
+// Open a file with an fopen()-like mode: r w a r+ w+ a+
+file*
+file_open(char *name, char *mode)
 {
-	int r = 0; regmatch_t pmatch;
-	regex_t *re = regex(pattern);
-	if (re && subject && *subject)
+	int flags = 0;
+	switch (mode ? mode[0]: 'r')
 	{
-		r = regexec(re, *subject, 1, &pmatch, 0) == 0 ?-1:0;
-		*subject += r ? pmatch.rm_so: strlen(*subject);
+		case 'r': flags = O_RDONLY; break;
+		case 'w': flags = O_WRONLY|O_CREAT|O_TRUNC; break;
+		case 'a': flags = O_WRONLY|O_CREAT|O_APPEND; break;
+		default: return NULL;
 	}
-	return r;
+	if (mode && strchr(mode, '+'))
+		flags = (flags & ~O_ACCMODE) | O_RDWR;
+
+	int fd = open(name, flags, 0666);
+	return fd < 0 ? NULL: file_fd(fd);
 }
 
-// POSIX regex split
-int
-split(char *pattern, char **subject)
+// Discard read-ahead so the file offset matches what has been consumed
+void
+file_unread(file *f)
 {
-	int r = 0; regmatch_t pmatch;
-	regex_t *re = regex(pattern);
-	if (re && *subject)
-	{
-		r = regexec(re, *subject, 1, &pmatch, 0) == 0 ?-1:0;
-		if (r)
-		{
-			memset(*subject + pmatch.rm_so, 0, pmatch.rm_eo - pmatch.rm_so);
-			*subject += pmatch.rm_eo;
-		}
-		else
-		{
-			*subject += strlen(*subject);
-		}
-	}
-	return r;
+	if (f->in.pos < f->in.len)
+		lseek(f->in.fd, f->in.pos - f->in.len, SEEK_CUR);
+	f->in.pos = f->in.len = 0;
 }
 
-#endif
-
-#ifdef LIB_FORK
-
-void catch_exit(int sig)
+cell
+file_read(file *f, char *buf, cell len)
 {
-	while (0 < waitpid(-1, NULL, WNOHANG));
+	out_flush(&f->out);
+	return in_bytes(&f->in, buf, len);
+}
+
+int
+file_line(file *f, char *buf, cell lim, cell *len)
+{
+	out_flush(&f->out);
+	return in_line(&f->in, buf, lim, len);
+}
+
+int
+file_write(file *f, char *data, cell len)
+{
+	file_unread(f);
+	return out_write(&f->out, data, len);
+}
+
+int
+file_seek(file *f, cell pos)
+{
+	out_flush(&f->out);
+	f->in.pos = f->in.len = 0;
+	return lseek(f->in.fd, pos, SEEK_SET) < 0 ? 0:-1;
+}
+
+cell
+file_size(file *f)
+{
+	struct stat st;
+	out_flush(&f->out);
+	return fstat(f->in.fd, &st) == 0 ? st.st_size: -1;
+}
+
+int
+file_close(file *f)
+{
+	int ok = out_flush(&f->out);
+	ok = close(f->in.fd) == 0 && ok;
+	free(f);
+	return ok ? -1:0;
+}
+
+// Write a file to disk
+int
+blurt(const char *name, char *data, cell dlen)
+{
+	file *f = file_open((char*)name, "w");
+	if (!f) return 0;
+	int ok = file_write(f, data, dlen);
+	return file_close(f) && ok;
+}
+
+// Write a file to disk via a temporary file and rename(), so readers see
+// either the old contents or the new, never a partial write
+int
+blurt_atomic(const char *name, char *data, cell dlen)
+{
+	char *tmp = malloc(strlen(name) + 8);
+	sprintf(tmp, "%s.XXXXXX", name);
+
+	int fd = mkstemp(tmp);
+	if (fd < 0)
+	{
+		free(tmp);
+		return 0;
+	}
+
+	// mkstemp() uses 0600; keep the mode of any file being replaced
+	struct stat st;
+	mode_t mask = umask(0); umask(mask);
+	fchmod(fd, stat(name, &st) == 0 ? st.st_mode & 07777: 0666 & ~mask);
+
+	file *f = file_fd(fd);
+	int ok = file_write(f, data, dlen) && out_flush(&f->out) && fsync(fd) == 0;
+	ok = file_close(f) && ok && rename(tmp, name) == 0;
+	if (!ok)
+		unlink(tmp);
+	free(tmp);
+	return ok;
+}
+
+// Cooperative tasks. Each task has its own data, return, alternate and
+// loop stacks; the interpreter's registers are swapped on YIELD. A task
+// that would block reading input or sleeping is parked instead, and a
+// poll() over every parked task picks who runs next. Tasks only switch
+// between words, and share everything else (dictionary, SOURCE, and
+// the current input and output). Building with -DTASK_BUDGET=n also
+// switches tasks every n words, for fairness without YIELD.
+//
+// A task's stacks are at least TASK_STACK cells, each between pages it
+// cannot touch, so running off one faults at once rather than corrupting
+// its neighbour. Stack depths are also checked at every switch.
+
+#define TASK_STACK 256
+#define TASK_READY 0
+#define TASK_WAIT  1
+#define TASK_JOIN  2
+#define TASK_DONE  3
+
+typedef struct _task {
+	struct _task *next, *prev, *joiner;
+	int state, fd, events;
+	cell wake, result;
+	cell *ds, *rs, *as, *ls;
+	cell *dsp, *rsp, *asp, *lsp, tos;
+	tok *ip, redo, start[2];
+	// cells in each stack, and the mapping holding them
+	cell room;
+	char *stacks;
+	size_t slen;
+} task;
+
+__thread task task_main, *task_current;
+__thread struct pollfd *task_polls;
+__thread task **task_polled;
+__thread int task_polls_max;
+
+#ifdef TASK_BUDGET
+__thread cell task_budget = TASK_BUDGET, task_ticks = TASK_BUDGET;
+#endif
+
+// True when some other task could run instead of blocking
+int
+tasks_other()
+{
+	return task_current && task_current->next != task_current;
+}
+
+task*
+task_new(tok xt, tok end)
+{
+	if (!task_current)
+	{
+		task_current = &task_main;
+		task_main.next = task_main.prev = &task_main;
+	}
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t room = (TASK_STACK * sizeof(cell) + page-1) / page * page;
+	char *m = mmap(NULL, page + 4 * (room + page), PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (m == MAP_FAILED)
+		return NULL;
+
+	// guard, ds, guard, rs, guard, as, guard, ls, guard
+	int i;
+	for (i = 0; i < 5; i++)
+		mprotect(m + i * (room + page), page, PROT_NONE);
+
+	task *t = calloc(1, sizeof(task));
+	t->stacks = m;
+	t->slen = page + 4 * (room + page);
+	t->room = room / sizeof(cell);
+	t->ds = (cell*)(m + page);
+	t->rs = (cell*)(m + page + (room + page));
+	t->as = (cell*)(m + page + (room + page) * 2);
+	t->ls = (cell*)(m + page + (room + page) * 3);
+	t->dsp = t->ds+3;
+	t->rsp = t->rs+3;
+	t->asp = t->as+3;
+	t->lsp = t->ls+3;
+	t->start[0] = xt;
+	t->start[1] = end;
+	t->ip = t->start;
+	t->fd = -1;
+
+	// run after every existing task
+	t->prev = task_main.prev;
+	t->next = &task_main;
+	task_main.prev->next = t;
+	task_main.prev = t;
+	return t;
+}
+
+void
+task_unlink(task *t)
+{
+	t->prev->next = t->next;
+	t->next->prev = t->prev;
+}
+
+void
+task_free(task *t)
+{
+	munmap(t->stacks, t->slen);
+	free(t);
+}
+
+cell
+task_usec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Park the current task until fd is ready, or usec pass (if > 0)
+void
+task_park(int fd, int events, cell usec)
+{
+	task_current->state = TASK_WAIT;
+	task_current->fd = fd;
+	task_current->events = events;
+	task_current->wake = usec > 0 ? task_usec() + usec: 0;
+}
+
+// Should reading this input park the task? Only if nothing is buffered
+// (a whole line, for line reads) and the descriptor has nothing either.
+int
+task_input(input *in, int line)
+{
+	if (!tasks_other())
+		return 0;
+	if (in->pos < in->len && (!line || memchr(in->buf + in->pos, '\n', in->len - in->pos)))
+		return 0;
+	struct pollfd pfd = { .fd = in->fd, .events = POLLIN };
+	if (poll(&pfd, 1, 0) > 0)
+		return 0;
+	if (in->tied)
+		out_flush_all();
+	task_park(in->fd, POLLIN, 0);
+	return 1;
+}
+
+// Choose the next task to run, round robin from the current one, polling
+// for parked tasks when nothing is ready. NULL means every task is
+// waiting on another.
+task*
+task_pick()
+{
+	task *t;
+	int i, n, count;
+	cell now, timeout;
+
+	for (;;)
+	{
+		t = task_current;
+		do
+		{
+			t = t->next;
+			if (t->state == TASK_READY)
+				return t;
+		}
+		while (t != task_current);
+
+		count = 0;
+		t = task_current;
+		do { count++; t = t->next; } while (t != task_current);
+
+		if (count > task_polls_max)
+		{
+			task_polls_max = count * 2;
+			task_polls = realloc(task_polls, task_polls_max * sizeof(struct pollfd));
+			task_polled = realloc(task_polled, task_polls_max * sizeof(task*));
+		}
+
+		n = 0;
+		timeout = -1;
+		now = task_usec();
+		t = task_current;
+		do
+		{
+			t = t->next;
+			if (t->state != TASK_WAIT)
+				continue;
+			if (t->wake && (timeout < 0 || t->wake - now < timeout))
+				timeout = t->wake > now ? t->wake - now: 0;
+			if (t->fd >= 0)
+			{
+				task_polls[n].fd = t->fd;
+				task_polls[n].events = t->events;
+				task_polls[n].revents = 0;
+				task_polled[n++] = t;
+			}
+		}
+		while (t != task_current);
+
+		if (!n && timeout < 0)
+			return NULL;
+
+		out_flush_all();
+		poll(task_polls, n, timeout < 0 ? -1: (int)((timeout + 999) / 1000));
+
+		for (i = 0; i < n; i++)
+			if (task_polls[i].revents)
+				task_polled[i]->state = TASK_READY;
+
+		now = task_usec();
+		t = task_current;
+		do
+		{
+			t = t->next;
+			if (t->state == TASK_WAIT && t->wake && t->wake <= now)
+				t->state = TASK_READY;
+		}
+		while (t != task_current);
+	}
+}
+
+// Growable vectors of cells, behind base.fs STACK, which lays out the
+// same fields. Room doubles, so pushes are amortized O(1)
+typedef struct {
+	cell size;
+	cell *data;
+	cell room;
+} vector;
+
+void
+vec_init(vector *v)
+{
+	v->size = 0;
+	v->room = 8;
+	v->data = malloc(sizeof(cell) * v->room);
+}
+
+void
+vec_reserve(vector *v, cell n)
+{
+	if (n > v->room)
+	{
+		cell room = v->room > 0 ? v->room: 8;
+		while (room < n)
+			room *= 2;
+		v->data = realloc(v->data, sizeof(cell) * room);
+		v->room = room;
+	}
+}
+
+// Hash maps from C strings (copied) or integers to cells, behind base.fs
+// DICT. Open addressing with linear probing over power-of-two tables of
+// hash, key, value slots. Growing is incremental: the old table stays
+// searchable and each write moves a few of its slots across
+#define MAP_EMPTY 0
+#define MAP_GONE 1
+#define MAP_MOVES 16
+
+typedef struct {
+	uint64_t hash;
+	cell key, value;
+} map_slot;
+
+typedef struct {
+	map_slot *slots;
+	cell mask, used; // used counts MAP_GONE too
+} map_table;
+
+typedef struct {
+	int ints;
+	cell count, moved;
+	map_table now, old;
+} map;
+
+uint64_t
+map_mix(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+uint64_t
+map_hash(map *m, cell key)
+{
+	uint64_t h, w;
+
+	if (m->ints)
+		h = map_mix(key);
+	else
+	{
+		// a word at a time
+		const char *s = (char*)key;
+		size_t len = strlen(s);
+		h = len * 0x9e3779b97f4a7c15ULL;
+		for (; len >= 8; len -= 8, s += 8)
+		{
+			memcpy(&w, s, 8);
+			h = (h ^ w) * 0xff51afd7ed558ccdULL;
+			h ^= h >> 29;
+		}
+		w = 0;
+		memcpy(&w, s, len);
+		h = map_mix(h ^ w);
+	}
+	return h > MAP_GONE ? h: h + 2;
+}
+
+void
+map_table_init(map_table *t, cell size)
+{
+	t->slots = calloc(size, sizeof(map_slot));
+	t->mask = size-1;
+	t->used = 0;
+}
+
+map*
+map_new(cell n, int ints)
+{
+	cell size = 16;
+	while (size < n*2)
+		size *= 2;
+
+	map *m = calloc(1, sizeof(map));
+	m->ints = ints;
+	map_table_init(&m->now, size);
+	return m;
+}
+
+map_slot*
+map_table_find(map *m, map_table *t, cell key, uint64_t h)
+{
+	if (!t->slots)
+		return NULL;
+
+	for (cell i = h & t->mask; ; i = (i+1) & t->mask)
+	{
+		map_slot *s = &t->slots[i];
+		if (s->hash == MAP_EMPTY)
+			return NULL;
+		if (s->hash == h && (m->ints ? s->key == key: !strcmp((char*)s->key, (char*)key)))
+			return s;
+	}
+}
+
+map_slot*
+map_find(map *m, cell key)
+{
+	uint64_t h = map_hash(m, key);
+	map_slot *s = map_table_find(m, &m->now, key, h);
+	return s ? s: map_table_find(m, &m->old, key, h);
+}
+
+// Place a slot known to be absent
+void
+map_table_put(map_table *t, map_slot *from)
+{
+	cell i = from->hash & t->mask;
+	while (t->slots[i].hash > MAP_GONE)
+		i = (i+1) & t->mask;
+	if (t->slots[i].hash == MAP_EMPTY)
+		t->used++;
+	t->slots[i] = *from;
+}
+
+// Move up to n slots of the old table into the new
+void
+map_move(map *m, cell n)
+{
+	while (m->old.slots && n--)
+	{
+		map_slot *s = &m->old.slots[m->moved];
+		if (s->hash > MAP_GONE)
+		{
+			map_table_put(&m->now, s);
+			// still searchable until the old table goes
+			s->hash = MAP_GONE;
+		}
+		if (++m->moved > m->old.mask)
+		{
+			free(m->old.slots);
+			m->old.slots = NULL;
+		}
+	}
+}
+
+void
+map_set(map *m, cell key, cell value)
+{
+	map_move(m, MAP_MOVES);
+
+	map_slot *s = map_find(m, key);
+	if (s)
+	{
+		s->value = value;
+		return;
+	}
+
+	// over 3/4 full, counting removed slots: start a fresh table
+	if ((m->now.used+1)*4 > (m->now.mask+1)*3)
+	{
+		map_move(m, m->old.mask+1);
+		m->old = m->now;
+		m->moved = 0;
+		cell size = 16;
+		while (size < (m->count+1)*4)
+			size *= 2;
+		map_table_init(&m->now, size);
+	}
+
+	map_slot slot = {
+		.hash = map_hash(m, key),
+		.key = m->ints ? key: (cell)strdup((char*)key),
+		.value = value,
+	};
+	map_table_put(&m->now, &slot);
+	m->count++;
+}
+
+cell
+map_remove(map *m, cell key)
+{
+	map_move(m, MAP_MOVES);
+
+	map_slot *s = map_find(m, key);
+	if (!s)
+		return 0;
+
+	cell value = s->value;
+	if (!m->ints)
+		free((char*)s->key);
+	s->hash = MAP_GONE;
+	m->count--;
+	return value;
+}
+
+void
+map_free(map *m)
+{
+	if (!m)
+		return;
+	map_table *tables[2] = { &m->now, &m->old };
+	for (int t = 0; t < 2; t++)
+	{
+		if (!tables[t]->slots)
+			continue;
+		if (!m->ints)
+			for (cell i = 0; i <= tables[t]->mask; i++)
+				if (tables[t]->slots[i].hash > MAP_GONE)
+					free((char*)tables[t]->slots[i].key);
+		free(tables[t]->slots);
+	}
+	free(m);
+}
+
+// The i'th live slot onward, for MAP_EACH: old table first, then new.
+// Returns NULL at the end
+map_slot*
+map_slot_at(map *m, cell *i)
+{
+	cell olds = m->old.slots ? m->old.mask+1: 0;
+	for (; *i < olds + m->now.mask+1; (*i)++)
+	{
+		map_slot *s = *i < olds ? &m->old.slots[*i]: &m->now.slots[*i - olds];
+		if (s->hash > MAP_GONE)
+			return s;
+	}
+	return NULL;
+}
+
+// Sort signed cells ascending: insertion sort when short, else LSD radix
+// on bytes, skipping any byte all keys share
+void
+sort_cells(cell *a, cell n)
+{
+	if (n < 64)
+	{
+		for (cell i = 1; i < n; i++)
+		{
+			cell x = a[i], j = i;
+			for (; j > 0 && a[j-1] > x; j--)
+				a[j] = a[j-1];
+			a[j] = x;
+		}
+		return;
+	}
+
+	cell *b = malloc(sizeof(cell) * n), *src = a, *dst = b, *t;
+	cell counts[256];
+	uint64_t flip = 1ULL << 63;
+
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		memset(counts, 0, sizeof(counts));
+		for (cell i = 0; i < n; i++)
+			counts[((src[i] ^ flip) >> shift) & 0xff]++;
+
+		if (counts[((src[0] ^ flip) >> shift) & 0xff] == n)
+			continue;
+
+		for (cell i = 0, sum = 0; i < 256; i++)
+		{
+			cell c = counts[i];
+			counts[i] = sum;
+			sum += c;
+		}
+		for (cell i = 0; i < n; i++)
+			dst[counts[((src[i] ^ flip) >> shift) & 0xff]++] = src[i];
+
+		t = src; src = dst; dst = t;
+	}
+
+	if (src != a)
+		memcpy(a, src, sizeof(cell) * n);
+	free(b);
+}
+
+int
+sort_strcmp(const void *a, const void *b)
+{
+	const char *s1 = *(char**)a, *s2 = *(char**)b;
+	return !s1 || !s2 ? (s1 != NULL) - (s2 != NULL): strcmp(s1, s2);
+}
+
+// SORT and MSORT merge bottom up, one comparison at a time, so that the
+// interpreter can run the comparison xt between steps
+typedef struct {
+	cell *a, *src, *dst, n, width, lo, mid, hi, i, j, k;
+} msorter;
+
+void
+msort_run(msorter *s)
+{
+	s->mid = s->lo + s->width < s->n ? s->lo + s->width: s->n;
+	s->hi = s->lo + s->width*2 < s->n ? s->lo + s->width*2: s->n;
+	s->i = s->k = s->lo;
+	s->j = s->mid;
+}
+
+msorter*
+msort_new(cell *a, cell n)
+{
+	msorter *s = malloc(sizeof(msorter) + sizeof(cell) * (n > 0 ? n: 0));
+	s->a = s->src = a;
+	s->dst = (cell*)(s+1);
+	s->n = n;
+	s->width = 1;
+	s->lo = 0;
+	msort_run(s);
+	return s;
+}
+
+// Returns 1 with the next pair to compare, x from the right run and y
+// from the left, or 0 once sorted
+int
+msort_next(msorter *s, cell *x, cell *y)
+{
+	while (s->width < s->n)
+	{
+		if (s->i < s->mid && s->j < s->hi)
+		{
+			*x = s->src[s->j];
+			*y = s->src[s->i];
+			return 1;
+		}
+		while (s->i < s->mid)
+			s->dst[s->k++] = s->src[s->i++];
+		while (s->j < s->hi)
+			s->dst[s->k++] = s->src[s->j++];
+
+		s->lo = s->hi;
+		if (s->lo >= s->n)
+		{
+			cell *t = s->src; s->src = s->dst; s->dst = t;
+			s->width *= 2;
+			s->lo = 0;
+		}
+		msort_run(s);
+	}
+	if (s->src != s->a)
+		memcpy(s->a, s->src, sizeof(cell) * s->n);
+	return 0;
+}
+
+// x goes before y: take from the right run, else the left keeps order
+void
+msort_take(msorter *s, int before)
+{
+	s->dst[s->k++] = before ? s->src[s->j++]: s->src[s->i++];
+}
+
+// A comparison that is just < or > (or a word of only that) orders plain
+// cells, which sort natively: returns 1 ascending, -1 descending, else 0
+int
+sort_native(tok xt)
+{
+	if (call[xt] == call[ENTER] && body[xt][1] == EXIT)
+		xt = body[xt][0];
+	return xt == LESS ? 1: xt == MORE ? -1: 0;
+}
+
+// OS threads. Each runs a word in an interpreter of its own (stacks,
+// scratch buffers, tasks, input and output are thread local) over the
+// shared dictionary, which is read-only while threads run: defining,
+// compiling and allotting words fail outside the main thread.
+
+typedef struct {
+	pthread_t id;
+	tok start[2];
+	tok *cp;
+	word *hp;
+	cell result;
+	cell *ds, *dsp; // embedded VMs keep their data stack between calls
+} thread;
+
+cell forth(int argc, char *argv[], thread *self);
+
+void*
+thread_main(void *arg)
+{
+	thread *t = arg;
+	dict_locked = 1;
+	t->result = forth(0, NULL, t);
+	// scratch buffers are per thread too
+	for (int i = 0; i < SPARSE_BUFS; i++)
+		free(sparse_bufs[i]);
+	for (int i = 0; i < FORMAT_BUFS; i++)
+		free(format_bufs[i]);
+	return NULL;
+}
+
+// Parallel loops. PFOR splits an index range over a pool of threads
+// plus the caller. Each worker owns a slice of the range and takes small
+// chunks from its front; one that runs dry steals the back half of the
+// largest slice left, so uneven iterations still balance.
+
+typedef struct {
+	pthread_mutex_t lock;
+	cell lo, hi; // indexes not yet taken
+	cell acc;    // PREDUCE partial result
+} pfor_slice;
+
+typedef struct {
+	tok xt, op;
+	cell grain;
+	int workers, running;
+	pfor_slice slices[];
+} pfor_job;
+
+struct {
+	pthread_mutex_t lock;
+	pthread_cond_t wake, done;
+	int size; // pool threads, not counting callers
+	cell gen;
+	pfor_job *job;
+} pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, -1 };
+
+__thread cell pool_gen;
+
+// Start pool threads on first use: PFOR_WORKERS, or one per core
+void
+pool_start(tok *cp, word *hp)
+{
+	char *env = getenv("PFOR_WORKERS");
+	int n = env ? atoi(env): sysconf(_SC_NPROCESSORS_ONLN);
+	pool.size = 0;
+
+	for (int i = 1; i < n; i++)
+	{
+		thread *t = calloc(1, sizeof(thread));
+		t->start[0] = PFOR_WORK;
+		t->start[1] = DIE;
+		t->cp = cp;
+		t->hp = hp;
+		t->result = i;
+		if (pthread_create(&t->id, NULL, thread_main, t) != 0)
+		{
+			free(t);
+			break;
+		}
+		pthread_detach(t->id);
+		pool.size++;
+	}
+}
+
+// Set up a loop of n iterations, handed to the pool if it is idle, else
+// run by the caller alone (eg, PFOR nested in a PFOR body)
+pfor_job*
+pfor_begin(cell n, tok xt, tok op, cell acc, tok *cp, word *hp)
+{
+	pthread_mutex_lock(&pool.lock);
+	if (pool.size < 0)
+		pool_start(cp, hp);
+	int shared = !pool.job && pool.size > 0;
+	int workers = shared ? pool.size+1: 1;
+
+	pfor_job *job = malloc(sizeof(pfor_job) + sizeof(pfor_slice) * workers);
+	job->xt = xt;
+	job->op = op;
+	job->workers = workers;
+	job->running = workers-1;
+	job->grain = n / (workers * 64);
+	if (job->grain < 1)
+		job->grain = 1;
+
+	n = n > 0 ? n: 0;
+	for (int i = 0; i < workers; i++)
+	{
+		pfor_slice *s = &job->slices[i];
+		pthread_mutex_init(&s->lock, NULL);
+		s->lo = n * i / workers;
+		s->hi = n * (i+1) / workers;
+		s->acc = acc;
+	}
+
+	if (shared)
+	{
+		pool.job = job;
+		pool.gen++;
+		pthread_cond_broadcast(&pool.wake);
+	}
+	pthread_mutex_unlock(&pool.lock);
+	return job;
+}
+
+// Take the next chunk of indexes for worker w, stealing if need be
+int
+pfor_take(pfor_job *job, int w, cell *lo, cell *hi)
+{
+	pfor_slice *s = &job->slices[w];
+
+	for (;;)
+	{
+		pthread_mutex_lock(&s->lock);
+		if (s->lo < s->hi)
+		{
+			*lo = s->lo;
+			*hi = s->lo + job->grain < s->hi ? s->lo + job->grain: s->hi;
+			s->lo = *hi;
+			pthread_mutex_unlock(&s->lock);
+			return 1;
+		}
+		pthread_mutex_unlock(&s->lock);
+
+		pfor_slice *victim = NULL;
+		cell most = 0;
+
+		for (int i = 0; i < job->workers; i++)
+		{
+			pfor_slice *v = &job->slices[i];
+			pthread_mutex_lock(&v->lock);
+			if (v->hi - v->lo > most)
+			{
+				most = v->hi - v->lo;
+				victim = v;
+			}
+			pthread_mutex_unlock(&v->lock);
+		}
+
+		if (!victim)
+			return 0;
+
+		cell from = 0, to = 0;
+		pthread_mutex_lock(&victim->lock);
+		if (victim->lo < victim->hi)
+		{
+			from = victim->lo + (victim->hi - victim->lo) / 2;
+			to = victim->hi;
+			victim->hi = from;
+		}
+		pthread_mutex_unlock(&victim->lock);
+
+		pthread_mutex_lock(&s->lock);
+		s->lo = from;
+		s->hi = to;
+		pthread_mutex_unlock(&s->lock);
+	}
+}
+
+// Pool thread: block until the next loop is posted
+pfor_job*
+pfor_wait()
+{
+	pthread_mutex_lock(&pool.lock);
+	while (pool.gen == pool_gen)
+		pthread_cond_wait(&pool.wake, &pool.lock);
+	pool_gen = pool.gen;
+	pfor_job *job = pool.job;
+	pthread_mutex_unlock(&pool.lock);
+	return job;
+}
+
+// Worker w has run out of indexes. Pool threads report in; the caller
+// waits for them, after which the job is its own to reduce and free
+void
+pfor_end(pfor_job *job, int w)
+{
+	out_flush_all();
+	pthread_mutex_lock(&pool.lock);
+	if (w)
+	{
+		if (--job->running == 0)
+			pthread_cond_signal(&pool.done);
+	}
+	else
+	{
+		while (job->running > 0)
+			pthread_cond_wait(&pool.done, &pool.lock);
+		if (pool.job == job)
+			pool.job = NULL;
+	}
+	pthread_mutex_unlock(&pool.lock);
+}
+
+void
+pfor_free(pfor_job *job)
+{
+	for (int i = 0; i < job->workers; i++)
+		pthread_mutex_destroy(&job->slices[i].lock);
+	free(job);
+}
+
+#ifdef LIB_REGEX
+
+#define REGEX_CACHE 4
+__thread char *re_patterns[REGEX_CACHE];
+__thread regex_t re_compiled[REGEX_CACHE];
+
+regex_t*
+regex(char *pattern)
+{
+	regex_t *re = NULL; int i;
+
+	// have we compiled this regex before?
+	for (i = 0; i < REGEX_CACHE; i++)
+	{
+		if (re_patterns[i] && same_name(pattern, re_patterns[i]))
+		{
+			re = &re_compiled[i];
+			break;
+		}
+	}
+	if (!re)
+	{
+		// look for a free cache slot
+		for (i = 0; i < REGEX_CACHE; i++)
+		{
+			if (!re_patterns[i])
+				break;
+		}
+		if (i == REGEX_CACHE)
+		{
+			// free the oldest
+			i = REGEX_CACHE - 1;
+			regfree(&re_compiled[0]); free(re_patterns[0]);
+			memmove(&re_compiled[0], &re_compiled[1], sizeof(regex_t) * i);
+			memmove(&re_patterns[0], &re_patterns[1], sizeof(char*)   * i);
+		}
+		re = &re_compiled[i];
+		re_patterns[i] = strdup(pattern);
+		if (regcomp(re, pattern, REG_EXTENDED) != 0)
+		{
+			re = NULL;
+			re_patterns[i] = NULL;
+		}
+	}
+	return re;
+}
+
+// POSIX regex match
+int
+match(char *pattern, char **subject)
+{
+	int r = 0; regmatch_t pmatch;
+	regex_t *re = regex(pattern);
+	if (re && subject && *subject)
+	{
+		r = regexec(re, *subject, 1, &pmatch, 0) == 0 ?-1:0;
+		*subject += r ? pmatch.rm_so: strlen(*subject);
+	}
+	return r;
+}
+
+// POSIX regex split
+int
+split(char *pattern, char **subject)
+{
+	int r = 0; regmatch_t pmatch;
+	regex_t *re = regex(pattern);
+	if (re && *subject)
+	{
+		r = regexec(re, *subject, 1, &pmatch, 0) == 0 ?-1:0;
+		if (r)
+		{
+			memset(*subject + pmatch.rm_so, 0, pmatch.rm_eo - pmatch.rm_so);
+			*subject += pmatch.rm_eo;
+		}
+		else
+		{
+			*subject += strlen(*subject);
+		}
+	}
+	return r;
+}
+
+#endif
+
+#ifdef LIB_FORK
+
+// Children from SPAWN and COPROC are waited for whenever the script
+// gets round to it. Rather than hold SIGCHLD off until then, which would
+// stop reaping for the whole process, they are listed here and
+// catch_exit() keeps their exit status for spawn_wait() to collect
+#define SPAWNED 256
+
+volatile struct {
+	pid_t pid;
+	int status, done;
+} spawned[SPAWNED];
+
+void catch_exit(int sig)
+{
+	int status, i;
+	pid_t pid;
+	while (0 < (pid = waitpid(-1, &status, WNOHANG)))
+	{
+		for (i = 0; i < SPAWNED; i++)
+		{
+			if (spawned[i].pid == pid)
+			{
+				spawned[i].status = status;
+				spawned[i].done = 1;
+				break;
+			}
+		}
+	}
 }
 
 #define EXEC_READ 0
 #define EXEC_WRITE 1
 
-// execute sub-process and connect its stdin=infp and stdout=outfp
-pid_t
-exec_cmd_io(const char *command, int *infp, int *outfp)
+// SIGCHLD is held off while commands we wait on are running, so that
+// catch_exit() can't reap them before their exit status is collected
+int sigchld_holds;
+sigset_t sigchld_saved;
+
+void
+sigchld_hold()
+{
+	if (!sigchld_holds++)
+	{
+		sigset_t set;
+		sigemptyset(&set);
+		sigaddset(&set, SIGCHLD);
+		sigprocmask(SIG_BLOCK, &set, &sigchld_saved);
+	}
+}
+
+void
+sigchld_release()
+{
+	if (!--sigchld_holds)
+		sigprocmask(SIG_SETMASK, &sigchld_saved, NULL);
+}
+
+extern char **environ;
+
+// Spawn a program with its stdin=infp and stdout=outfp. Uses posix_spawn()
+// which, unlike fork(), need not copy the interpreter's page tables.
+pid_t
+spawn_io(const char *prog, char *const argv[], int *infp, int *outfp)
+{
+	int p_stdin[2], p_stdout[2];
+	pid_t pid;
+
+	if (pipe2(p_stdin, O_CLOEXEC) != 0)
+		return -1;
+	if (pipe2(p_stdout, O_CLOEXEC) != 0)
+	{
+		close(p_stdin[EXEC_READ]);
+		close(p_stdin[EXEC_WRITE]);
+		return -1;
+	}
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, p_stdin[EXEC_READ], EXEC_READ);
+	posix_spawn_file_actions_adddup2(&actions, p_stdout[EXEC_WRITE], EXEC_WRITE);
+
+	// children get default SIGPIPE and the signal mask we had before any hold
+	sigset_t defaults, mask;
+	sigemptyset(&defaults);
+	sigaddset(&defaults, SIGPIPE);
+	if (sigchld_holds)
+		mask = sigchld_saved;
+	else
+		sigprocmask(SIG_BLOCK, NULL, &mask);
+
+	posix_spawnattr_t attr;
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setsigdefault(&attr, &defaults);
+	posix_spawnattr_setsigmask(&attr, &mask);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF|POSIX_SPAWN_SETSIGMASK);
+
+	out_flush_all();
+	if (posix_spawnp(&pid, prog, &actions, &attr, argv, environ) != 0)
+		pid = -1;
+
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&actions);
+
+	close(p_stdin[EXEC_READ]);
+	close(p_stdout[EXEC_WRITE]);
+
+	if (pid < 0 || infp == NULL)
+		close(p_stdin[EXEC_WRITE]);
+	else
+		*infp = p_stdin[EXEC_WRITE];
+	if (pid < 0 || outfp == NULL)
+		close(p_stdout[EXEC_READ]);
+	else
+		*outfp = p_stdout[EXEC_READ];
+	return pid;
+}
+
+// Commands without shell syntax can skip /bin/sh and be run directly
+int
+shell_free(const char *command)
+{
+	return !strpbrk(command, "|&;<>()$`\\\"'*?[]#~=!{}\n");
+}
+
+// execute sub-process and connect its stdin=infp and stdout=outfp
+pid_t
+exec_cmd_io(const char *command, int *infp, int *outfp)
+{
+	signal(SIGCHLD, catch_exit);
+	pid_t pid = -1;
+
+	if (shell_free(command))
+	{
+		char *copy = strdup(command), *argv[64], *arg;
+		int argc = 0;
+		for (arg = strtok(copy, " \t"); arg && argc < 63; arg = strtok(NULL, " \t"))
+			argv[argc++] = arg;
+		argv[argc] = NULL;
+		// on failure fall through, so sh reports any error the usual way
+		if (argc && !arg)
+			pid = spawn_io(argv[0], argv, infp, outfp);
+		free(copy);
+	}
+	if (pid < 0)
+	{
+		char *argv[] = { "sh", "-c", (char*)command, NULL };
+		pid = spawn_io("/bin/sh", argv, infp, outfp);
+	}
+	return pid;
+}
+
+pid_t
+exec_cmd(const char *cmd)
+{
+	pid_t pid;
+	signal(SIGCHLD, catch_exit);
+	out_flush_all();
+	pid = fork();
+	if (!pid)
+	{
+		setsid();
+		execlp("/bin/sh", "sh", "-c", cmd, NULL);
+		exit(EXIT_FAILURE);
+	}
+	return pid;
+}
+
+int
+exit_status(int status)
+{
+	return WIFEXITED(status) ? WEXITSTATUS(status): 128 + WTERMSIG(status);
+}
+
+// Wait for a child and return its exit status, or 128+signal
+int
+exec_wait(pid_t pid)
+{
+	int status = 0;
+	if (waitpid(pid, &status, 0) < 0)
+		return -1;
+	return exit_status(status);
+}
+
+// List a child for spawn_wait(). Call with SIGCHLD held, so it can't be
+// reaped before it is listed. With the list full the child is waited for
+// as usual, but its status is lost (-1) if catch_exit() reaps it first
+void
+spawn_track(pid_t pid)
+{
+	int i;
+	for (i = 0; i < SPAWNED; i++)
+	{
+		if (!spawned[i].pid)
+		{
+			spawned[i].done = 0;
+			spawned[i].pid = pid;
+			return;
+		}
+	}
+}
+
+// Exit status of a listed child, whether or not catch_exit() got it first
+int
+spawn_wait(pid_t pid)
+{
+	int i, status = -1, found = 0;
+	sigchld_hold();
+	for (i = 0; i < SPAWNED; i++)
+	{
+		if (spawned[i].pid == pid)
+		{
+			if ((found = spawned[i].done))
+				status = exit_status(spawned[i].status);
+			spawned[i].pid = 0;
+			break;
+		}
+	}
+	if (!found)
+		status = exec_wait(pid);
+	sigchld_release();
+	return status;
+}
+
+// Anonymous MAP_SHARED memory is inherited across fork(), so children
+// can leave results where their parent will see them. A header cell
+// keeps the mapping's length for munmap()
+void*
+shm_allocate(cell n)
+{
+	size_t len = sizeof(cell) + (n > 0 ? n: 0);
+	cell *p = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		return NULL;
+	p[0] = len;
+	return p+1;
+}
+
+void
+shm_free(void *a)
+{
+	if (a)
+	{
+		cell *p = (cell*)a - 1;
+		munmap(p, p[0]);
+	}
+}
+
+// Fork up to workers-1 children for FORK-MAP, handing each an equal
+// slice of n items. The parent keeps the rest, including any slice a
+// failed fork() leaves over, and gets the children's pids (0 ended) to
+// wait for; a child gets NULL
+pid_t*
+fork_slices(cell n, int workers, cell *lo, cell *hi)
+{
+	int w;
+	pid_t pid, *pids;
+
+	if (workers < 1)
+		workers = 1;
+
+	pids = calloc(workers, sizeof(pid_t));
+
+	for (w = 0; w < workers-1; w++)
+	{
+		pid = fork();
+
+		if (pid == 0)
+		{
+			free(pids);
+			// pool threads do not survive fork(); start afresh if needed
+			pthread_mutex_init(&pool.lock, NULL);
+			pool.size = -1;
+			pool.job = NULL;
+			if (task_current)
+				task_current->next = task_current->prev = task_current;
+			*lo = n * w / workers;
+			*hi = n * (w+1) / workers;
+			return NULL;
+		}
+		if (pid < 0)
+			break;
+
+		pids[w] = pid;
+	}
+
+	*lo = n * w / workers;
+	*hi = n;
+	return pids;
+}
+
+// Wait for every worker. Returns 0 if any failed or crashed, leaving
+// its slice unprocessed
+int
+fork_wait(pid_t *pids)
+{
+	int ok = 1;
+	for (pid_t *p = pids; *p; p++)
+		ok = exec_wait(*p) == 0 && ok;
+	free(pids);
+	return ok;
+}
+
+#define PUMP_BUF 1024*64
+
+// A running command whose stdin is fed while its stdout is drained, so
+// neither side can fill a pipe and deadlock the other
+typedef struct {
+	pid_t pid;
+	int in, out;
+	const char *data;
+	size_t len, pos;
+	char buf[PUMP_BUF];
+} pump;
+
+pump*
+pump_open(const char *cmd, const char *data)
+{
+	sigchld_hold();
+
+	pump *p = calloc(1, sizeof(pump));
+	p->pid = exec_cmd_io(cmd, &p->in, &p->out);
+	if (p->pid < 0)
+	{
+		sigchld_release();
+		free(p);
+		return NULL;
+	}
+	p->data = data ? data: "";
+	p->len = strlen(p->data);
+	fcntl(p->in, F_SETFL, fcntl(p->in, F_GETFL) | O_NONBLOCK);
+	if (!p->len)
+	{
+		close(p->in);
+		p->in = -1;
+	}
+	return p;
+}
+
+// Block until some output arrives, feeding stdin meanwhile.
+// Returns bytes read into buf, or 0 at end of output.
+cell
+pump_read(pump *p, char *buf, cell lim)
+{
+	struct pollfd fds[2];
+	for (;;)
+	{
+		fds[0].fd = p->out;
+		fds[0].events = POLLIN;
+		fds[1].fd = p->in;
+		fds[1].events = POLLOUT;
+
+		if (poll(fds, p->in < 0 ? 1: 2, -1) < 0)
+			continue;
+
+		if (p->in >= 0 && fds[1].revents)
+		{
+			sigset_t old;
+			sigpipe_block(&old);
+			ssize_t rc = fds[1].revents & POLLOUT
+				? write(p->in, p->data + p->pos, p->len - p->pos): -1;
+			sigpipe_unblock(&old);
+			if (rc > 0)
+				p->pos += rc;
+			if (rc < 0 || p->pos == p->len)
+			{
+				close(p->in);
+				p->in = -1;
+			}
+		}
+		if (fds[0].revents)
+		{
+			ssize_t rc = read(p->out, buf, lim);
+			return rc > 0 ? rc: 0;
+		}
+	}
+}
+
+// Close the pipes and return the command's exit status
+int
+pump_close(pump *p)
+{
+	if (p->in >= 0)
+		close(p->in);
+	close(p->out);
+	int status = exec_wait(p->pid);
+	sigchld_release();
+	free(p);
+	return status;
+}
+
+char*
+sys_exec(const char *cmd, const char *data)
+{
+	size_t len = 0, lim = 1024;
+	char *res = malloc(lim+1);
+
+	pump *p = pump_open(cmd, data);
+	if (p)
+	{
+		cell rc;
+		while ((rc = pump_read(p, res+len, lim-len)) > 0)
+		{
+			len += rc;
+			if (len == lim)
+			{
+				lim *= 2;
+				res = realloc(res, lim+1);
+			}
+		}
+		pump_close(p);
+	}
+	res[len] = 0;
+	return res;
+}
+
+// Run n commands with at most jobs running at once, multiplexing their
+// output in one poll() loop. Returns an array of n strings in input order.
+char**
+sys_exec_all(char **cmds, cell n, cell jobs)
+{
+	if (jobs < 1)
+		jobs = sysconf(_SC_NPROCESSORS_ONLN);
+
+	char **res = calloc(n ? n: 1, sizeof(char*));
+	size_t *lens = calloc(n ? n: 1, sizeof(size_t));
+	size_t *lims = calloc(n ? n: 1, sizeof(size_t));
+
+	pump **slots = calloc(jobs, sizeof(pump*));
+	cell *owner = calloc(jobs, sizeof(cell));
+	struct pollfd *fds = calloc(jobs, sizeof(struct pollfd));
+	cell next = 0, running = 0, k, m;
+
+	for (;;)
+	{
+		for (k = 0; k < jobs && next < n; k++)
+		{
+			if (slots[k]) continue;
+			lims[next] = 1024;
+			res[next] = malloc(lims[next]+1);
+			res[next][0] = 0;
+			if ((slots[k] = pump_open(cmds[next], NULL)))
+			{
+				owner[k] = next;
+				running++;
+			}
+			next++;
+		}
+		if (!running)
+			break;
+
+		for (k = 0, m = 0; k < jobs; k++)
+		{
+			fds[k].fd = slots[k] ? slots[k]->out: -1;
+			fds[k].events = POLLIN;
+			fds[k].revents = 0;
+		}
+		if (poll(fds, jobs, -1) < 0)
+			continue;
+
+		for (k = 0; k < jobs; k++)
+		{
+			if (!slots[k] || !fds[k].revents)
+				continue;
+			m = owner[k];
+			ssize_t rc = read(slots[k]->out, res[m] + lens[m], lims[m] - lens[m]);
+			if (rc > 0)
+			{
+				lens[m] += rc;
+				if (lens[m] == lims[m])
+				{
+					lims[m] *= 2;
+					res[m] = realloc(res[m], lims[m]+1);
+				}
+				continue;
+			}
+			res[m][lens[m]] = 0;
+			pump_close(slots[k]);
+			slots[k] = NULL;
+			running--;
+		}
+	}
+	free(fds);
+	free(owner);
+	free(slots);
+	free(lims);
+	free(lens);
+	return res;
+}
+
+// A long-lived child with both pipes held open, so repeated queries cost
+// a round trip rather than a spawn each time
+typedef struct {
+	pid_t pid;
+	file *to, *from;
+} coproc;
+
+coproc*
+coproc_open(const char *cmd)
+{
+	int in, out;
+	sigchld_hold();
+	pid_t pid = exec_cmd_io(cmd, &in, &out);
+	if (pid >= 0)
+		spawn_track(pid);
+	sigchld_release();
+	if (pid < 0)
+		return NULL;
+	coproc *c = malloc(sizeof(coproc));
+	c->pid = pid;
+	c->to = file_fd(in);
+	c->to->out.quiet = 1;
+	c->from = file_fd(out);
+	return c;
+}
+
+int
+coproc_send(coproc *c, char *data)
+{
+	return file_write(c->to, data, strlen(data)) ? -1:0;
+}
+
+int
+coproc_recv_line(coproc *c, char *buf, cell lim, cell *len)
+{
+	out_flush(&c->to->out);
+	return in_line(&c->from->in, buf, lim, len);
+}
+
+// Send one line and read one line back
+int
+coproc_ask(coproc *c, char *data, char *buf, cell lim, cell *len)
+{
+	*len = 0;
+	if (!coproc_send(c, data) || !file_write(c->to, "\n", 1))
+		return 0;
+	return coproc_recv_line(c, buf, lim, len);
+}
+
+// Close the child's stdin and wait for it to finish
+int
+coproc_close(coproc *c)
+{
+	file_close(c->to);
+	file_close(c->from);
+	int status = spawn_wait(c->pid);
+	free(c);
+	return status;
+}
+
+#endif
+
+#ifdef LIB_SERVE
+
+// An event-driven HTTP/1.1 server. One warm interpreter handles every
+// request: the handler word reads the request from KEY/READ-LINE and its
+// TYPE/EMIT output is captured as the response, then framed with a
+// Content-Length so connections can be kept alive.
+
+#define REQUEST_BUF INPUT_BUF
+#define SERVE_EVENTS 64
+
+typedef struct {
+	int fd, keep, writing;
+	size_t rlen, need;
+	char *wbuf;
+	size_t wlen, wpos;
+	int ffd;
+	off_t foff;
+	size_t fleft;
+	char rbuf[REQUEST_BUF];
+} conn;
+
+typedef struct {
+	int fd, epfd;
+	int nevents, ievent;
+	struct epoll_event events[SERVE_EVENTS];
+	conn *current, *again;
+	input in, *in_saved;
+	output out, *out_saved;
+	int ffd;
+	off_t foff;
+	// captured output up to the end of SEND-FILE's headers
+	size_t flen, fhead;
+} server;
+
+__thread server *serving;
+
+// Find a header's value in a block of HTTP headers
+char*
+http_header(char *hdrs, size_t len, const char *name, size_t *vlen)
+{
+	size_t nlen = strlen(name);
+	char *p = hdrs, *end = hdrs + len;
+	while (p < end)
+	{
+		char *eol = memchr(p, '\n', end - p);
+		if (!eol) eol = end;
+		if (eol - p > nlen && p[nlen] == ':' && !strncasecmp(p, name, nlen))
+		{
+			char *v = p + nlen + 1, *e = eol;
+			while (v < e && (*v == ' ' || *v == '\t')) v++;
+			while (e > v && (e[-1] == '\r' || e[-1] == ' ')) e--;
+			*vlen = e - v;
+			return v;
+		}
+		p = eol + 1;
+	}
+	return NULL;
+}
+
+// Length of the header block including the blank line, or 0 if incomplete
+size_t
+http_headers_end(char *buf, size_t len)
+{
+	char *crlf = memmem(buf, len, "\r\n\r\n", 4);
+	char *lf = memmem(buf, len, "\n\n", 2);
+	if (crlf && (!lf || crlf < lf))
+		return crlf - buf + 4;
+	return lf ? lf - buf + 2: 0;
+}
+
+// Parse a Content-Length value: digits only, with no sign, space or
+// overflow. Returns 0 if it is malformed
+int
+http_length(char *v, size_t vlen, size_t *n)
+{
+	char *e;
+	if (!vlen || *v < '0' || *v > '9')
+		return 0;
+	unsigned long long u = strtoull(v, &e, 10);
+	*n = u;
+	return e == v + vlen && u != (unsigned long long)-1 && u == *n;
+}
+
+#define HTTP_BAD ((size_t)-1)
+#define HTTP_TOO_LARGE ((size_t)-2)
+
+// Length of the first complete request in a buffer, 0 if incomplete,
+// HTTP_BAD for a malformed Content-Length, or HTTP_TOO_LARGE for one
+// that could never fit in a request buffer
+size_t
+http_complete(char *buf, size_t len)
+{
+	size_t hlen = http_headers_end(buf, len), vlen, body = 0;
+	if (!hlen)
+		return 0;
+	char *v = http_header(buf, hlen, "Content-Length", &vlen);
+	if (v && !http_length(v, vlen, &body))
+		return HTTP_BAD;
+	if (body > REQUEST_BUF - hlen)
+		return HTTP_TOO_LARGE;
+	return hlen + body <= len ? hlen + body: 0;
+}
+
+int
+http_keep_alive(char *req, size_t len)
+{
+	size_t vlen;
+	char *eol = memchr(req, '\n', len);
+	int old = eol && memmem(req, eol - req, "HTTP/1.0", 8);
+	char *v = http_header(req, len, "Connection", &vlen);
+	if (v && vlen >= 5 && !strncasecmp(v, "close", 5))
+		return 0;
+	if (v && vlen >= 10 && !strncasecmp(v, "keep-alive", 10))
+		return 1;
+	return !old;
+}
+
+void
+conn_close(server *s, conn *c)
+{
+	epoll_ctl(s->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+	close(c->fd);
+	if (c->ffd >= 0)
+		close(c->ffd);
+	free(c->wbuf);
+	free(c);
+}
+
+void
+conn_watch(server *s, conn *c, int writing)
+{
+	struct epoll_event ev;
+	ev.events = writing ? EPOLLOUT: EPOLLIN;
+	ev.data.ptr = c;
+	epoll_ctl(s->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+	c->writing = writing;
+}
+
+// Write as much of a pending response as the socket takes.
+// Returns 0 if the connection was closed.
+int
+conn_flush(server *s, conn *c)
+{
+	while (c->wpos < c->wlen)
+	{
+		ssize_t rc = send(c->fd, c->wbuf + c->wpos, c->wlen - c->wpos, MSG_NOSIGNAL);
+		if (rc < 0)
+		{
+			// full socket buffer, or gone; poll tells us which
+			if (!c->writing)
+				conn_watch(s, c, 1);
+			return 1;
+		}
+		c->wpos += rc;
+	}
+	// then any file body, straight from the page cache
+	int sent = 0;
+	while (c->fleft)
+	{
+		sigset_t old;
+		sigpipe_block(&old);
+		ssize_t rc = sendfile(c->fd, c->ffd, &c->foff, c->fleft);
+		sigpipe_unblock(&old);
+		if (rc < 0 && c->writing && !sent)
+		{
+			// poll said writable, so this is a real error
+			conn_close(s, c);
+			return 0;
+		}
+		if (rc < 0)
+		{
+			conn_watch(s, c, 1);
+			return 1;
+		}
+		// a file truncated under us leaves the response short; give up
+		c->fleft = rc ? c->fleft - rc: 0;
+		sent = 1;
+		if (!rc) c->keep = 0;
+	}
+	if (c->ffd >= 0)
+	{
+		close(c->ffd);
+		c->ffd = -1;
+	}
+	free(c->wbuf);
+	c->wbuf = NULL;
+	c->wlen = c->wpos = 0;
+	if (!c->keep)
+	{
+		conn_close(s, c);
+		return 0;
+	}
+	if (c->writing)
+		conn_watch(s, c, 0);
+	return 1;
+}
+
+// Set the length of the next complete request on a connection, or 0
+// while incomplete. A bad Content-Length is answered 400, a request too
+// large to buffer 413, and the connection closed: returns 0 if so
+int
+conn_request(server *s, conn *c)
+{
+	static char *bad = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+	static char *too_large = "HTTP/1.1 413 Request Entity Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+	size_t need = http_complete(c->rbuf, c->rlen);
+	if (need == HTTP_BAD || need == HTTP_TOO_LARGE || (!need && c->rlen == REQUEST_BUF))
+	{
+		char *res = need == HTTP_BAD ? bad: too_large;
+		send(c->fd, res, strlen(res), MSG_NOSIGNAL);
+		conn_close(s, c);
+		return 0;
+	}
+	c->need = need;
+	return 1;
+}
+
+// Read whatever has arrived. Returns 0 if the connection was closed.
+int
+conn_read(server *s, conn *c)
+{
+	while (c->rlen < REQUEST_BUF)
+	{
+		ssize_t rc = read(c->fd, c->rbuf + c->rlen, REQUEST_BUF - c->rlen);
+		if (rc == 0)
+		{
+			conn_close(s, c);
+			return 0;
+		}
+		if (rc < 0)
+			return 1;
+		c->rlen += rc;
+	}
+	return conn_request(s, c);
+}
+
+void
+server_accept(server *s)
+{
+	int fd, one = 1;
+	while ((fd = accept4(s->fd, NULL, NULL, SOCK_NONBLOCK|SOCK_CLOEXEC)) >= 0)
+	{
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		conn *c = calloc(1, sizeof(conn));
+		c->fd = fd;
+		c->ffd = -1;
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.ptr = c;
+		epoll_ctl(s->epfd, EPOLL_CTL_ADD, fd, &ev);
+	}
+}
+
+server*
+server_open(int port, int reuseport)
+{
+	int one = 1;
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+
+	int fd = socket(AF_INET, SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC, 0);
+	if (fd < 0)
+		return NULL;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (reuseport)
+		setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one));
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0)
+	{
+		errorf("serve: cannot listen on port %d", port);
+		close(fd);
+		return NULL;
+	}
+
+	server *s = calloc(1, sizeof(server));
+	s->fd = fd;
+	s->epfd = epoll_create1(EPOLL_CLOEXEC);
+	s->in.fd = -1;
+	s->out.fd = -1;
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	epoll_ctl(s->epfd, EPOLL_CTL_ADD, fd, &ev);
+	return s;
+}
+
+// A load generator. Keeps a number of keep-alive connections to a
+// local port busy with GET requests for a mix of paths, and times each
+// response. Results are a cell array: completed, errors, elapsed usec,
+// then p50, p90, p99, max and mean latency in usec, then counts of
+// responses taking under 2^i usec for LOAD_BUCKETS buckets.
+
+#define LOAD_BUCKETS 32
+#define LOAD_STATS (8 + LOAD_BUCKETS)
+#define LOAD_PATHS 64
+
+typedef struct {
+	int fd, close;
+	cell start;
+	size_t got, need;
+	char buf[REQUEST_BUF];
+} load_conn;
+
+cell
+load_usec()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int
+load_cmp(const void *a, const void *b)
+{
+	cell x = *(cell*)a, y = *(cell*)b;
+	return x < y ? -1: x > y;
+}
+
+int
+load_connect(int epfd, load_conn *c, int port)
+{
+	struct sockaddr_in addr;
+	int one = 1;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+
+	c->fd = socket(AF_INET, SOCK_STREAM|SOCK_CLOEXEC, 0);
+	if (c->fd < 0 || connect(c->fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+	{
+		if (c->fd >= 0) close(c->fd);
+		c->fd = -1;
+		return 0;
+	}
+	setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = c;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+	return 1;
+}
+
+void
+load_drop(int epfd, load_conn *c)
+{
+	if (c->fd >= 0)
+	{
+		epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+		close(c->fd);
+	}
+	c->fd = -1;
+}
+
+cell*
+http_load(char *paths, int conns, int total, int port)
+{
+	char *reqs[LOAD_PATHS], *p, *e;
+	int nreqs = 0, i, epfd, sent = 0, done = 0, errors = 0, idle = 0;
+	cell *stats = calloc(LOAD_STATS, sizeof(cell));
+	cell *lat = calloc(total > 0 ? total: 1, sizeof(cell));
+
+	for (p = paths; p && *p && nreqs < LOAD_PATHS; p = e)
+	{
+		p += strspn(p, " ");
+		if (!*p) break;
+		e = p + strcspn(p, " ");
+		reqs[nreqs] = malloc(e - p + 64);
+		sprintf(reqs[nreqs++], "GET %.*s HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n", (int)(e - p), p);
+	}
+	if (!nreqs)
+		reqs[nreqs++] = strdup("GET / HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n");
+
+	if (conns < 1) conns = 1;
+	if (conns > total) conns = total > 0 ? total: 1;
+
+	load_conn *cs = calloc(conns, sizeof(load_conn));
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+
+	cell began = load_usec();
+
+	// start every connection, then send the next request as each answers
+	for (i = 0; i < conns; i++)
+		cs[i].fd = -1;
+
+	while (done + errors < total)
+	{
+		for (i = 0; i < conns && sent < total; i++)
+		{
+			load_conn *c = &cs[i];
+			if (c->start || (c->fd < 0 && !load_connect(epfd, c, port)))
+				continue;
+			char *req = reqs[sent % nreqs];
+			c->got = c->need = 0;
+			c->start = load_usec();
+			sent++;
+			if (!write_quiet(c->fd, req, strlen(req)))
+			{
+				load_drop(epfd, c);
+				c->start = 0;
+				errors++;
+			}
+		}
+
+		struct epoll_event events[64];
+		int n = epoll_wait(epfd, events, 64, 1000);
+		if (n <= 0 && ++idle == 10)
+		{
+			// nothing for ten seconds; count the rest as failed
+			errors = total - done;
+			break;
+		}
+		if (n > 0) idle = 0;
+
+		for (i = 0; i < n; i++)
+		{
+			load_conn *c = events[i].data.ptr;
+
+			// once the headers are in, body bytes are only counted
+			char *at = c->need ? c->buf: c->buf + c->got;
+			size_t room = c->need ? REQUEST_BUF: REQUEST_BUF - c->got;
+			ssize_t rc = read(c->fd, at, room);
+			if (rc <= 0)
+			{
+				load_drop(epfd, c);
+				if (c->start)
+				{
+					c->start = 0;
+					errors++;
+				}
+				continue;
+			}
+			c->got += rc;
+
+			if (!c->need)
+			{
+				size_t hlen = http_headers_end(c->buf, c->got), vlen;
+				if (!hlen && c->got == REQUEST_BUF)
+				{
+					load_drop(epfd, c);
+					c->start = 0;
+					errors++;
+					continue;
+				}
+				if (!hlen)
+					continue;
+				char *v = http_header(c->buf, hlen, "Content-Length", &vlen);
+				size_t body = 0;
+				if (v && !http_length(v, vlen, &body))
+				{
+					load_drop(epfd, c);
+					c->start = 0;
+					errors++;
+					continue;
+				}
+				c->need = hlen + body;
+				v = http_header(c->buf, hlen, "Connection", &vlen);
+				c->close = v && vlen >= 5 && !strncasecmp(v, "close", 5);
+			}
+
+			if (c->got < c->need)
+				continue;
+
+			cell took = load_usec() - c->start;
+			lat[done++] = took;
+			c->start = 0;
+			c->got = c->need = 0;
+
+			int b = 0;
+			while (b < LOAD_BUCKETS-1 && took >= ((cell)1 << b)) b++;
+			stats[8+b]++;
+
+			if (c->close)
+				load_drop(epfd, c);
+		}
+	}
+
+	stats[0] = done;
+	stats[1] = errors;
+	stats[2] = load_usec() - began;
+
+	if (done)
+	{
+		cell sum = 0;
+		qsort(lat, done, sizeof(cell), load_cmp);
+		for (i = 0; i < done; i++)
+			sum += lat[i];
+		stats[3] = lat[(done-1) * 50 / 100];
+		stats[4] = lat[(done-1) * 90 / 100];
+		stats[5] = lat[(done-1) * 99 / 100];
+		stats[6] = lat[done-1];
+		stats[7] = sum / done;
+	}
+
+	for (i = 0; i < conns; i++)
+		load_drop(epfd, &cs[i]);
+	for (i = 0; i < nreqs; i++)
+		free(reqs[i]);
+	close(epfd);
+	free(cs);
+	free(lat);
+	return stats;
+}
+
+#define PREFORK_MAX 256
+
+pid_t prefork_pids[PREFORK_MAX];
+int prefork_workers;
+volatile sig_atomic_t prefork_stopping;
+
+// Pass SIGTERM or SIGINT on to the workers; the parent reaps them as usual
+void
+prefork_stop(int sig)
+{
+	int i;
+	prefork_stopping = 1;
+	for (i = 0; i < prefork_workers; i++)
+		if (prefork_pids[i] > 0) kill(prefork_pids[i], sig);
+}
+
+// Fork worker processes that share the compiled dictionary copy-on-write.
+// Returns 1 in each worker. The parent stays here supervising, restarts
+// workers that crash, and returns 0 once every worker has exited.
+int
+prefork(int workers)
 {
-	signal(SIGCHLD, catch_exit);
-	int p_stdin[2], p_stdout[2];
+	int i, status, live = 0;
 	pid_t pid;
 
-	if (pipe(p_stdin) != 0 || pipe(p_stdout) != 0)
-		return -1;
-	pid = fork();
-	if (pid < 0)
-		return pid;
-	else if (pid == 0)
+	if (workers < 1)
+		workers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (workers > PREFORK_MAX)
+		workers = PREFORK_MAX;
+
+	prefork_workers = workers;
+	prefork_stopping = 0;
+	signal(SIGCHLD, SIG_DFL);
+	out_flush_all();
+
+	for (i = 0; i < workers; i++)
+	{
+		if (!(pid = fork()))
+			return 1;
+		prefork_pids[i] = pid;
+		live += pid > 0;
+	}
+
+	// wait() restarts after the handler rather than failing with EINTR
+	struct sigaction stop = { .sa_handler = prefork_stop, .sa_flags = SA_RESTART };
+	sigemptyset(&stop.sa_mask);
+	sigaction(SIGTERM, &stop, NULL);
+	sigaction(SIGINT, &stop, NULL);
+
+	while (live && (pid = wait(&status)) > 0)
+	{
+		for (i = 0; i < workers && prefork_pids[i] != pid; i++);
+		if (i == workers)
+			continue;
+
+		prefork_pids[i] = 0;
+		live--;
+
+		// a crash gets a replacement; a clean exit or being told to stop doesn't
+		if (!prefork_stopping && WIFSIGNALED(status) && WTERMSIG(status) != SIGTERM && WTERMSIG(status) != SIGINT)
+		{
+			errorf("serve: worker %d died with signal %d, restarting", pid, WTERMSIG(status));
+			usleep(100000);
+			if (!(pid = fork()))
+			{
+				signal(SIGTERM, SIG_DFL);
+				signal(SIGINT, SIG_DFL);
+				return 1;
+			}
+			prefork_pids[i] = pid;
+			live += pid > 0;
+			// told to stop while forking
+			if (prefork_stopping && pid > 0)
+				kill(pid, SIGTERM);
+		}
+	}
+
+	signal(SIGTERM, SIG_DFL);
+	signal(SIGINT, SIG_DFL);
+	return 0;
+}
+
+// Wait for a complete request and point KEY and TYPE at it
+conn*
+server_next(server *s)
+{
+	conn *c = s->again;
+	s->again = NULL;
+
+	while (!c)
+	{
+		if (s->ievent == s->nevents)
+		{
+			out_flush_all();
+			s->ievent = 0;
+			s->nevents = epoll_wait(s->epfd, s->events, SERVE_EVENTS, -1);
+			if (s->nevents < 0)
+				s->nevents = 0;
+			continue;
+		}
+		struct epoll_event *e = &s->events[s->ievent++];
+		if (!e->data.ptr)
+		{
+			server_accept(s);
+			continue;
+		}
+		c = e->data.ptr;
+		if (e->events & EPOLLERR || (c->writing && e->events & EPOLLHUP))
+		{
+			conn_close(s, c);
+			c = NULL;
+		}
+		else
+		if (c->writing && !conn_flush(s, c))
+			c = NULL;
+		else
+		if (!c->writing && e->events & (EPOLLIN|EPOLLHUP|EPOLLERR) && !conn_read(s, c))
+			c = NULL;
+		else
+		if (c->writing || !conn_request(s, c) || !c->need)
+			c = NULL;
+	}
+
+	s->current = c;
+	memcpy(s->in.buf, c->rbuf, c->need);
+	s->in.pos = 0;
+	s->in.len = c->need;
+	s->out.len = 0;
+	s->out.mlen = 0;
+	s->ffd = -1;
+	serving = s;
+	s->in_saved = in_current;
+	s->out_saved = out_current;
+	in_current = &s->in;
+	out_current = &s->out;
+	return c;
+}
+
+// Copy a header block, ending every line with CRLF whatever the
+// handler used, so the lines framing adds never mix terminators
+size_t
+http_crlf(char *dst, const char *src, size_t len)
+{
+	size_t i, n = 0;
+	for (i = 0; i < len; i++)
+	{
+		if (src[i] == '\n' && (!i || src[i-1] != '\r'))
+			dst[n++] = '\r';
+		dst[n++] = src[i];
+	}
+	if (n && dst[n-1] != '\n')
+	{
+		dst[n++] = '\r';
+		dst[n++] = '\n';
+	}
+	return n;
+}
+
+// Frame the captured output as an HTTP response. Handlers may write a
+// full response with status line and headers, or just a body.
+void
+http_frame(conn *c, char *res, size_t len)
+{
+	size_t vlen;
+	char head[128];
+
+	c->wpos = 0;
+
+	if (len > 5 && !strncmp(res, "HTTP/", 5))
+	{
+		size_t hlen = http_headers_end(res, len), stop;
+		if (!hlen)
+		{
+			// headers only, no blank line
+			hlen = len;
+			stop = len;
+		}
+		else
+		{
+			stop = res[hlen-2] == '\r' ? hlen-2: hlen-1;
+		}
+
+		char *v = http_header(res, stop, "Connection", &vlen);
+		if (v && vlen >= 5 && !strncasecmp(v, "close", 5))
+			c->keep = 0;
+
+		// 1xx, 204 and 304 responses have no body to count
+		int n = 0, bodiless = len > 12 && (res[9] == '1' || !strncmp(res+9, "204", 3) || !strncmp(res+9, "304", 3));
+		if (!bodiless && !http_header(res, stop, "Content-Length", &vlen) && !http_header(res, stop, "Transfer-Encoding", &vlen))
+			n += sprintf(head+n, "Content-Length: %lu\r\n", (unsigned long)(len - hlen));
+		if (!c->keep && !v)
+			n += sprintf(head+n, "Connection: close\r\n");
+
+		c->wbuf = malloc(len + stop + 256);
+		c->wlen = http_crlf(c->wbuf, res, stop);
+		memcpy(c->wbuf + c->wlen, head, n);
+		c->wlen += n;
+		memcpy(c->wbuf + c->wlen, "\r\n", 2);
+		c->wlen += 2;
+		memcpy(c->wbuf + c->wlen, res + hlen, len - hlen);
+		c->wlen += len - hlen;
+	}
+	else
+	{
+		int n = sprintf(head, "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: %lu\r\n%s\r\n",
+			(unsigned long)len, c->keep ? "": "Connection: close\r\n");
+		c->wbuf = malloc(len + 256);
+		memcpy(c->wbuf, head, n);
+		memcpy(c->wbuf + n, res, len);
+		c->wlen = n + len;
+	}
+}
+
+// A response cache. Handlers opt in with CACHE-PAGE; entries are keyed
+// by method, URI and any CACHE-VARY headers, expire after their TTL, and
+// the least recently used go first once CACHE_LIMIT bytes are held.
+
+#define CACHE_SLOTS 1024
+#define CACHE_LIMIT 1024*1024*16
+
+typedef struct _cached {
+	struct _cached *chain, *newer, *older;
+	uint64_t hash;
+	cell expires;
+	size_t klen, rlen;
+	char *res;
+	char key[];
+} cached;
+
+struct {
+	cached *slots[CACHE_SLOTS];
+	cached *newest, *oldest;
+	size_t bytes, limit;
+	cell hits, misses, ttl;
+	char *vary, *key;
+	size_t klen;
+} cache = { .limit = CACHE_LIMIT };
+
+uint64_t
+cache_hash(char *key, size_t len)
+{
+	uint64_t h = 14695981039346656037ULL;
+	while (len--)
+		h = (h ^ (unsigned char)*key++) * 1099511628211ULL;
+	return h;
+}
+
+cell
+cache_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec;
+}
+
+// Build "METHOD URI" plus the value of each CACHE-VARY header.
+// Only GET and HEAD are cacheable; returns 0 otherwise.
+size_t
+cache_key(char *req, size_t len, char *key)
+{
+	char *sp1 = memchr(req, ' ', len), *sp2, *v, *name;
+	size_t n, vlen, nlen;
+	if (!sp1 || !(sp2 = memchr(sp1+1, ' ', req + len - sp1 - 1)))
+		return 0;
+	if (strncmp(req, "GET ", 4) && strncmp(req, "HEAD ", 5))
+		return 0;
+	n = sp2 - req;
+	if (key) memcpy(key, req, n);
+	for (name = cache.vary; name && *name; name += nlen)
+	{
+		name += strspn(name, " ,");
+		nlen = strcspn(name, " ,");
+		if (!nlen)
+			break;
+		char tmp[nlen+1];
+		memcpy(tmp, name, nlen);
+		tmp[nlen] = 0;
+		v = http_header(req, len, tmp, &vlen);
+		if (!v) vlen = 0;
+		if (key)
+		{
+			key[n] = '\n';
+			memcpy(key + n + 1, v, vlen);
+		}
+		n += vlen + 1;
+	}
+	return n;
+}
+
+void
+cache_unlink(cached *e)
+{
+	cached **pp = &cache.slots[e->hash % CACHE_SLOTS];
+	while (*pp != e) pp = &(*pp)->chain;
+	*pp = e->chain;
+	if (e->newer) e->newer->older = e->older; else cache.newest = e->older;
+	if (e->older) e->older->newer = e->newer; else cache.oldest = e->newer;
+	cache.bytes -= sizeof(cached) + e->klen + e->rlen;
+	free(e->res);
+	free(e);
+}
+
+void
+cache_touch(cached *e)
+{
+	if (cache.newest == e)
+		return;
+	// unless it is a new entry, not yet listed, take it out first
+	if (e->newer)
+	{
+		e->newer->older = e->older;
+		if (e->older) e->older->newer = e->newer; else cache.oldest = e->newer;
+	}
+	e->newer = NULL;
+	e->older = cache.newest;
+	if (cache.newest) cache.newest->newer = e;
+	cache.newest = e;
+	if (!cache.oldest) cache.oldest = e;
+}
+
+cached*
+cache_find(char *key, size_t klen, uint64_t hash)
+{
+	cached *e = cache.slots[hash % CACHE_SLOTS];
+	while (e && !(e->hash == hash && e->klen == klen && !memcmp(e->key, key, klen)))
+		e = e->chain;
+	return e;
+}
+
+void
+cache_store(char *key, size_t klen, char *res, size_t rlen, cell ttl)
+{
+	uint64_t hash = cache_hash(key, klen);
+	size_t bytes = sizeof(cached) + klen + rlen;
+	cached *e = cache_find(key, klen, hash);
+
+	if (e)
+		cache_unlink(e);
+	if (bytes > cache.limit)
+		return;
+	while (cache.oldest && cache.bytes + bytes > cache.limit)
+		cache_unlink(cache.oldest);
+
+	e = calloc(1, sizeof(cached) + klen);
+	e->hash = hash;
+	e->expires = cache_now() + ttl;
+	e->klen = klen;
+	memcpy(e->key, key, klen);
+	e->rlen = rlen;
+	e->res = malloc(rlen + 1);
+	memcpy(e->res, res, rlen);
+
+	cached **slot = &cache.slots[hash % CACHE_SLOTS];
+	e->chain = *slot;
+	*slot = e;
+	cache.bytes += bytes;
+	cache_touch(e);
+}
+
+// Send the framed response and move on to any pipelined request
+void
+server_send(server *s, conn *c, char *res, size_t len)
+{
+	c->keep = http_keep_alive(c->rbuf, c->need);
+	http_frame(c, res, len);
+
+	// keep any pipelined bytes that followed the request
+	memmove(c->rbuf, c->rbuf + c->need, c->rlen - c->need);
+	c->rlen -= c->need;
+	c->need = 0;
+
+	if (conn_flush(s, c) && !c->wlen && conn_request(s, c) && c->need)
+		s->again = c;
+}
+
+void
+server_restore(server *s)
+{
+	s->current = NULL;
+	serving = NULL;
+	in_current = s->in_saved;
+	out_current = s->out_saved;
+}
+
+// Answer the current request from the cache if possible. Returns 1 if
+// it was sent, otherwise remembers the key in case the handler caches.
+int
+server_cached(server *s)
+{
+	conn *c = s->current;
+	size_t klen = cache_key(c->rbuf, c->need, NULL);
+
+	free(cache.key);
+	cache.key = NULL;
+	cache.ttl = 0;
+
+	if (!klen)
+		return 0;
+
+	cache.key = malloc(klen);
+	cache.klen = cache_key(c->rbuf, c->need, cache.key);
+
+	cached *e = cache_find(cache.key, cache.klen, cache_hash(cache.key, cache.klen));
+	if (e && e->expires <= cache_now())
+	{
+		cache_unlink(e);
+		e = NULL;
+	}
+	if (!e)
+	{
+		cache.misses++;
+		return 0;
+	}
+
+	cache.hits++;
+	cache_touch(e);
+	server_restore(s);
+	server_send(s, c, e->res, e->rlen);
+	return 1;
+}
+
+// Restore KEY and TYPE, and send the captured response
+void
+server_respond(server *s)
+{
+	conn *c = s->current;
+	server_restore(s);
+	out_flush(&s->out);
+
+	if (s->ffd >= 0)
+	{
+		// SEND-FILE body goes out after the headers
+		s->out.mlen = s->fhead;
+		c->ffd = s->ffd;
+		c->foff = s->foff;
+		c->fleft = s->flen;
+		s->ffd = -1;
+	}
+	else
+	if (cache.ttl > 0 && cache.key)
+		cache_store(cache.key, cache.klen, s->out.mem, s->out.mlen, cache.ttl);
+
+	server_send(s, c, s->out.mem ? s->out.mem: "", s->out.mlen);
+}
+
+#endif
+
+// HTTP request parsing. PARSE-REQUEST makes one pass over a request
+// buffer, NUL terminating each part in place (like SPLIT), so the
+// slices it records are also ordinary strings. Headers are indexed by
+// a case-insensitive hash for constant time lookup.
+
+#define REQUEST_HEADERS 64
+#define REQUEST_SLOTS 128
+
+typedef struct {
+	char *a;
+	cell n;
+} slice;
+
+typedef struct {
+	slice method, path, query, version, body;
+	int headers;
+	slice names[REQUEST_HEADERS], values[REQUEST_HEADERS];
+	unsigned char slots[REQUEST_SLOTS];
+} request;
+
+unsigned int
+header_hash(const char *name, size_t len)
+{
+	unsigned int h = 2166136261u;
+	while (len--)
+		h = (h ^ (*name++ | 0x20)) * 16777619u;
+	return h;
+}
+
+// Finds the end of the token starting at p that stops at any of
+// delims, or the line end. Returns NULL past the buffer end. A stray
+// NUL also stops a token, so requests containing one are rejected.
+char*
+request_token(char *p, char *end, const char *delims)
+{
+	while (p < end && *p != '\r' && *p != '\n' && !strchr(delims, *p))
+		p++;
+	return p < end ? p: NULL;
+}
+
+// Advance past a line end, returning NULL if the buffer runs out
+char*
+request_eol(char *p, char *end)
+{
+	if (p < end && *p == '\r') p++;
+	return p < end && *p == '\n' ? p+1: NULL;
+}
+
+slice*
+request_header(request *r, const char *name, size_t len)
+{
+	unsigned int i = header_hash(name, len);
+	unsigned char n;
+	while ((n = r->slots[i % REQUEST_SLOTS]))
+	{
+		slice *k = &r->names[n-1];
+		if (k->n == len && !strncasecmp(k->a, name, len))
+			return &r->values[n-1];
+		i++;
+	}
+	return NULL;
+}
+
+// Parse a complete request head. Returns NULL if it is malformed or
+// the blank line ending the headers is missing.
+request*
+request_parse(char *buf, size_t len)
+{
+	char *p = buf, *end = buf + len, *e;
+	request *r = calloc(1, sizeof(request));
+
+	#define slice_to(s,e) (s).a = p; (s).n = (e) - p
+
+	// request line: METHOD SP PATH [? QUERY] SP VERSION
+	if (!(e = request_token(p, end, " ")) || *e != ' ' || e == p)
+		goto fail;
+	slice_to(r->method, e);
+	*e = 0;
+	p = e+1;
+
+	if (!(e = request_token(p, end, " ?")) || e == p)
+		goto fail;
+	slice_to(r->path, e);
+	if (*e == '?')
+	{
+		*e = 0;
+		p = e+1;
+		if (!(e = request_token(p, end, " ")))
+			goto fail;
+		slice_to(r->query, e);
+	}
+	if (*e != ' ')
+		goto fail;
+	*e = 0;
+	p = e+1;
+
+	if (!(e = request_token(p, end, "")))
+		goto fail;
+	slice_to(r->version, e);
+	if (!(p = request_eol(e, end)))
+		goto fail;
+	*e = 0;
+
+	// headers up to a blank line
+	for (;;)
+	{
+		if ((e = request_eol(p, end)))
+		{
+			if (e < end)
+			{
+				r->body.a = e;
+				r->body.n = end - e;
+			}
+			*p = 0;
+			break;
+		}
+
+		char *colon = request_token(p, end, ":"), *v, *ve;
+		if (!colon || *colon != ':' || colon == p)
+			goto fail;
+
+		v = colon+1;
+		while (v < end && (*v == ' ' || *v == '\t')) v++;
+		if (!(ve = request_token(v, end, "")))
+			goto fail;
+		if (!(e = request_eol(ve, end)))
+			goto fail;
+
+		if (r->headers < REQUEST_HEADERS)
+		{
+			int n = r->headers++;
+			slice_to(r->names[n], colon);
+			p = v;
+			while (ve > v && (ve[-1] == ' ' || ve[-1] == '\t')) ve--;
+			slice_to(r->values[n], ve);
+
+			// first of any repeated header wins
+			if (!request_header(r, r->names[n].a, r->names[n].n))
+			{
+				unsigned int i = header_hash(r->names[n].a, r->names[n].n);
+				while (r->slots[i % REQUEST_SLOTS]) i++;
+				r->slots[i % REQUEST_SLOTS] = n+1;
+			}
+		}
+		*colon = 0;
+		*ve = 0;
+		p = e;
+	}
+
+	#undef slice_to
+	return r;
+fail:
+	free(r);
+	return NULL;
+}
+
+// URL routing. Patterns registered with ROUTE are compiled into one
+// trie of path segments: literal segments, :name captures, and a *name
+// wildcard that takes the rest of the path. Literal edges live in a
+// single hash table keyed by parent node and segment, so DISPATCH costs
+// one lookup per segment however many routes exist. Routes sharing a
+// :param or * position share the name first given to it.
+
+#define ROUTE_BUCKETS 1024
+#define ROUTE_SEGMENTS 64
+#define ROUTE_PARAMS 16
+#define ROUTE_PATH 4096
+
+typedef struct _route {
+	cell xt;
+	struct _route *param, *wild;
+	char *pname, *wname;
+} route;
+
+typedef struct _route_edge {
+	route *parent, *child;
+	struct _route_edge *next;
+	char seg[];
+} route_edge;
+
+route route_root;
+route_edge *route_edges[ROUTE_BUCKETS];
+
+__thread struct {
+	char *name, *value;
+} route_params[ROUTE_PARAMS];
+__thread int route_nparams;
+
+__thread char route_path[ROUTE_PATH*2];
+__thread char *route_segs[ROUTE_SEGMENTS], *route_tails[ROUTE_SEGMENTS];
+__thread int route_nsegs;
+
+unsigned int
+route_hash(route *parent, const char *seg)
+{
+	unsigned int h = 2166136261u ^ (unsigned int)(size_t)parent;
+	while (*seg)
+		h = (h ^ (unsigned char)*seg++) * 16777619u;
+	return h % ROUTE_BUCKETS;
+}
+
+route*
+route_child(route *parent, const char *seg)
+{
+	route_edge *e = route_edges[route_hash(parent, seg)];
+	while (e && !(e->parent == parent && !strcmp(e->seg, seg)))
+		e = e->next;
+	return e ? e->child: NULL;
+}
+
+// Split a path at slashes, ignoring empty segments and any query. A raw
+// copy is kept alongside so a wildcard can capture the whole tail.
+int
+route_split(const char *uri)
+{
+	size_t len = strcspn(uri, "?#");
+	char *raw = route_path, *seg = route_path + ROUTE_PATH, *p;
+
+	if (len >= ROUTE_PATH)
+		return 0;
+	memcpy(raw, uri, len);
+	raw[len] = 0;
+	memcpy(seg, uri, len);
+	seg[len] = 0;
+
+	route_nsegs = 0;
+	for (p = seg; *p; )
+	{
+		if (*p == '/')
+		{
+			*p++ = 0;
+			continue;
+		}
+		if (route_nsegs == ROUTE_SEGMENTS)
+			return 0;
+		route_tails[route_nsegs] = raw + (p - seg);
+		route_segs[route_nsegs++] = p;
+		p += strcspn(p, "/");
+	}
+	return 1;
+}
+
+void
+route_add(const char *pattern, cell xt)
+{
+	route *r = &route_root, *n;
+	int i;
+
+	if (!route_split(pattern))
+		return;
+
+	for (i = 0; i < route_nsegs; i++)
+	{
+		char *seg = route_segs[i];
+		if (*seg == ':')
+		{
+			if (!r->param)
+			{
+				r->param = calloc(1, sizeof(route));
+				r->pname = strdup(seg+1);
+			}
+			r = r->param;
+		}
+		else
+		if (*seg == '*')
+		{
+			if (!r->wild)
+			{
+				r->wild = calloc(1, sizeof(route));
+				r->wname = strdup(seg+1);
+			}
+			r = r->wild;
+			break;
+		}
+		else
+		{
+			if (!(n = route_child(r, seg)))
+			{
+				unsigned int h = route_hash(r, seg);
+				route_edge *e = calloc(1, sizeof(route_edge) + strlen(seg) + 1);
+				strcpy(e->seg, seg);
+				e->parent = r;
+				e->child = n = calloc(1, sizeof(route));
+				e->next = route_edges[h];
+				route_edges[h] = e;
+			}
+			r = n;
+		}
+	}
+	r->xt = xt;
+}
+
+void
+route_capture(char *name, char *value)
+{
+	if (route_nparams < ROUTE_PARAMS)
+	{
+		route_params[route_nparams].name = name;
+		route_params[route_nparams++].value = value;
+	}
+}
+
+// Match segments from i, preferring literal over :param over *wild
+route*
+route_match(route *r, int i)
+{
+	route *n, *m;
+	int saved = route_nparams;
+
+	if (i == route_nsegs && r->xt)
+		return r;
+
+	if (i < route_nsegs)
+	{
+		if ((n = route_child(r, route_segs[i])) && (m = route_match(n, i+1)))
+			return m;
+		if (r->param)
+		{
+			route_capture(r->pname, route_segs[i]);
+			if ((m = route_match(r->param, i+1)))
+				return m;
+			route_nparams = saved;
+		}
+	}
+	if (r->wild && r->wild->xt)
+	{
+		route_capture(r->wname, i < route_nsegs ? route_tails[i]: "");
+		return r->wild;
+	}
+	return NULL;
+}
+
+// Returns the xt for a path, with captures set, or 0
+cell
+route_find(const char *uri)
+{
+	route *r;
+	route_nparams = 0;
+	return route_split(uri) && (r = route_match(&route_root, 0)) ? r->xt: 0;
+}
+
+char*
+route_param(const char *name)
+{
+	int i;
+	for (i = 0; i < route_nparams; i++)
+		if (!strcmp(route_params[i].name, name))
+			return route_params[i].value;
+	return NULL;
+}
+
+// Static files. SEND-FILE writes the response headers, then the body
+// goes from the file to the socket or stdout with sendfile() without
+// passing through the heap. Single byte ranges and ETag revalidation
+// are answered; under SERVE the request headers come from the
+// connection, otherwise from the CGI environment.
+//
+// It writes a whole response, so it should be a handler's last output.
+// Under SERVE a second call is refused, and anything typed after it is
+// dropped rather than sent outside the Content-Length; through CGI it
+// would follow the body.
+
+const char*
+mime_type(const char *path)
+{
+	static const char *types[] = {
+		".html", "text/html", ".htm", "text/html", ".txt", "text/plain",
+		".css", "text/css", ".js", "application/javascript",
+		".json", "application/json", ".xml", "application/xml",
+		".svg", "image/svg+xml", ".png", "image/png", ".jpg", "image/jpeg",
+		".jpeg", "image/jpeg", ".gif", "image/gif", ".ico", "image/x-icon",
+		".wasm", "application/wasm", ".pdf", "application/pdf", NULL,
+	};
+	const char *ext = strrchr(path, '.');
+	int i;
+	for (i = 0; ext && types[i]; i += 2)
+		if (!strcasecmp(ext, types[i])) return types[i+1];
+	return "application/octet-stream";
+}
+
+// Parse a single "bytes=a-b" range. Returns 1 with *from and *to set,
+// 0 to send the whole file, or -1 if the range can't be satisfied.
+int
+http_range(const char *v, size_t vlen, off_t size, off_t *from, off_t *to)
+{
+	char buf[64], *p, *e;
+	if (!v || vlen >= sizeof(buf))
+		return 0;
+	memcpy(buf, v, vlen);
+	buf[vlen] = 0;
+	if (strncmp(buf, "bytes=", 6) || strchr(buf, ','))
+		return 0;
+	p = buf + 6;
+	if (*p == '-')
 	{
-		close(p_stdin[EXEC_WRITE]);
-		dup2(p_stdin[EXEC_READ], EXEC_READ);
-		close(p_stdout[EXEC_READ]);
-		dup2(p_stdout[EXEC_WRITE], EXEC_WRITE);
-		execlp("/bin/sh", "sh", "-c", command, NULL);
-		exit(EXIT_FAILURE);
+		off_t n = strtoull(p+1, &e, 10);
+		if (e == p+1 || *e)
+			return 0;
+		if (!n || !size)
+			return -1;
+		*from = n < size ? size - n: 0;
+		*to = size - 1;
+		return 1;
 	}
-	if (infp == NULL)
-		close(p_stdin[EXEC_WRITE]);
-	else
-		*infp = p_stdin[EXEC_WRITE];
-	if (outfp == NULL)
-		close(p_stdout[EXEC_READ]);
-	else
-		*outfp = p_stdout[EXEC_READ];
-	close(p_stdin[EXEC_READ]);
-	close(p_stdout[EXEC_WRITE]);
-	return pid;
+	*from = strtoull(p, &e, 10);
+	if (e == p || *e++ != '-')
+		return 0;
+	*to = *e ? strtoull(e, &p, 10): size - 1;
+	if (*e && *p)
+		return 0;
+	if (*to >= size)
+		*to = size - 1;
+	return *from < size && *from <= *to ? 1: -1;
 }
 
-pid_t
-exec_cmd(const char *cmd)
+// Copy part of a file to an output the slow way
+void
+file_copy(int fd, off_t off, size_t len, output *o)
 {
-	pid_t pid;
-	signal(SIGCHLD, catch_exit);
-	pid = fork();
-	if (!pid)
+	char buf[OUTPUT_BUF];
+	ssize_t rc;
+	while (len && (rc = pread(fd, buf, len < sizeof(buf) ? len: sizeof(buf), off)) > 0)
 	{
-		setsid();
-		execlp("/bin/sh", "sh", "-c", cmd, NULL);
-		exit(EXIT_FAILURE);
+		out_write(o, buf, rc);
+		off += rc;
+		len -= rc;
 	}
-	return pid;
 }
 
-char*
-sys_exec(const char *cmd, const char *data)
+int
+send_file(char *path)
 {
-	int in, out;
-	exec_cmd_io(cmd, &in, &out);
+	struct stat st;
+	char etag[64], head[512];
+	const char *range = NULL, *inm = NULL;
+	size_t rlen = 0, ilen = 0;
+	off_t from = 0, to = 0;
+	int n, fd, body = 1, partial;
+
+#ifdef LIB_SERVE
+	if (serving && serving->ffd >= 0)
+		return 0;
+#endif
+	if ((fd = open(path, O_RDONLY|O_CLOEXEC)) < 0)
+		return 0;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+		close(fd);
+		return 0;
+	}
+
+#ifdef LIB_SERVE
+	if (serving)
+	{
+		conn *c = serving->current;
+		size_t hlen = http_headers_end(c->rbuf, c->need);
+		range = http_header(c->rbuf, hlen, "Range", &rlen);
+		inm = http_header(c->rbuf, hlen, "If-None-Match", &ilen);
+		body = strncmp(c->rbuf, "HEAD ", 5) != 0;
+	}
+	else
+#endif
+	{
+		char *method = getenv("REQUEST_METHOD");
+		if ((range = getenv("HTTP_RANGE"))) rlen = strlen(range);
+		if ((inm = getenv("HTTP_IF_NONE_MATCH"))) ilen = strlen(inm);
+		body = !method || strcmp(method, "HEAD");
+	}
 
-	if (data)
-		write(in, data, strlen(data));
-	close(in);
+	snprintf(etag, sizeof(etag), "\"%lx-%lx\"", (unsigned long)st.st_mtime, (unsigned long)st.st_size);
 
-	int len = 0;
-	char *res = malloc(1024);
-	for (;;)
+	if (inm && ((ilen == 1 && *inm == '*') || memmem(inm, ilen, etag, strlen(etag))))
 	{
-		int rc = read(out, res+len, 1023);
-		if (rc > 0) len += rc;
-		if (rc < 1023) break;
-		res = realloc(res, len+1024);
+		n = snprintf(head, sizeof(head), "HTTP/1.1 304 Not Modified\r\nETag: %s\r\n\r\n", etag);
+		out_write(out_current, head, n);
+		close(fd);
+		return 1;
 	}
-	res[len] = 0;
-	close(out);
-	return res;
-}
 
+	partial = http_range(range, rlen, st.st_size, &from, &to);
+
+	if (partial < 0)
+	{
+		n = snprintf(head, sizeof(head), "HTTP/1.1 416 Range Not Satisfiable\r\n"
+			"Content-Range: bytes */%lu\r\nContent-Length: 0\r\n\r\n", (unsigned long)st.st_size);
+		out_write(out_current, head, n);
+		close(fd);
+		return 1;
+	}
+
+	if (!partial)
+	{
+		from = 0;
+		to = st.st_size - 1;
+	}
+
+	size_t len = to - from + 1;
+
+	n = snprintf(head, sizeof(head), "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %lu\r\n"
+		"ETag: %s\r\nAccept-Ranges: bytes\r\n",
+		partial ? "206 Partial Content": "200 OK", mime_type(path), (unsigned long)len, etag);
+	if (partial)
+		n += snprintf(head+n, sizeof(head)-n, "Content-Range: bytes %lu-%lu/%lu\r\n",
+			(unsigned long)from, (unsigned long)to, (unsigned long)st.st_size);
+	n += snprintf(head+n, sizeof(head)-n, "\r\n");
+	out_write(out_current, head, n);
+
+	if (!body || !st.st_size)
+	{
+		close(fd);
+		return 1;
+	}
+
+#ifdef LIB_SERVE
+	if (serving)
+	{
+		// handed to the connection once the headers are framed
+		out_flush(&serving->out);
+		serving->ffd = fd;
+		serving->foff = from;
+		serving->flen = len;
+		serving->fhead = serving->out.mlen;
+		return 1;
+	}
 #endif
 
+	output *o = out_current;
+	out_flush(o);
+	while (o->fd >= 0 && len)
+	{
+		ssize_t rc = sendfile(o->fd, fd, &from, len);
+		if (rc <= 0)
+			break;
+		len -= rc;
+	}
+	file_copy(fd, from, len, o);
+	close(fd);
+	return 1;
+}
+
 tok init[] = { EVALUATE, BYE };
 
 #include "src_base.c"
@@ -1057,7 +4511,7 @@ tok init[] = { EVALUATE, BYE };
 #endif
 
 // Use GCC's &&label syntax to find code word adresses.
-#define CODE(x) call[(x)] = &&code_##x; if (0) { code_##x:
+#define CODE(x) if (boot) call[(x)] = &&code_##x; if (0) { code_##x:
 
 // Framework to execute a Forth word from inside a CODE block (mainly for EVALUATE)
 #define IEXECUTE(x,l) do { iexec[0] = (x); iexec[1] = GOTO; *rsp++ = (cell)&&iexec_##l; *rsp++ = (cell)ip; ip = iexec; INEXT } while(0); iexec_##l:
@@ -1067,17 +4521,29 @@ tok init[] = { EVALUATE, BYE };
 
 #ifdef DEBUG
 #define NEXT goto next; }
+#elif defined(TASK_BUDGET)
+#define NEXT if (--task_ticks < 0) goto task_tick; INEXT }
 #else
 #define NEXT INEXT }
 #endif
 
-int
-main(int argc, char *argv[], char *env[])
+// Run the interpreter: the whole system when self is NULL, otherwise a
+// thread's word over the dictionary the main thread already built
+cell
+forth(int argc, char *argv[], thread *self)
 {
-	cell ds[STACK]; // Data stack
-	cell rs[STACK]; // Return stack
-	cell as[STACK]; // Alternate data stack (PUSH, POP, TOP)
-	cell ls[STACK]; // Loop stack
+	// embedded, the first call boots the system in a context of its own
+	int boot = !self || !self->hp;
+	char *fsrc = NULL;
+
+	cell ds0[STACK]; // Data stack
+	cell rs0[STACK]; // Return stack
+	cell as0[STACK]; // Alternate data stack (PUSH, POP, TOP)
+	cell ls0[STACK]; // Loop stack
+
+	// Stacks of the running task
+	cell *ds = ds0, *rs = rs0, *as = as0, *ls = ls0;
+	task *tp;
 
 	// Both these variables are used in NEXT and should have first-dibs on being in
 	// a register. The C compiler is free to ignore the "register" keyword, but some
@@ -1100,8 +4566,6 @@ main(int argc, char *argv[], char *env[])
 	word *w, *hp;
 	void *voidp;
 
-	srand(time(0));
-
 #define RSP_MY  -1
 #define RSP_AT  -2
 #define RSP_LSP -3
@@ -1122,11 +4586,27 @@ main(int argc, char *argv[], char *env[])
 #ifdef LIB_SHELL
 	int input_state = 0;
 	int pty_state = 0;
+	cell pty_lines = 0;
 	struct termios old_tio, new_tio;
 	stdin_current = stdin;
 	stdout_current = stdout;
 #endif
 
+	in_current = &in_std;
+	out_current = &out_std;
+	in_std.fd = fileno(stdin);
+	in_std.tied = 1;
+	out_std.fd = fileno(stdout);
+	out_std.lines = isatty(out_std.fd) ? -1: 0;
+	out_err.fd = fileno(stderr);
+	out_err.lines = -1;
+
+	if (!boot)
+		goto vm_init;
+
+	atexit(out_flush_all);
+	srand(time(0));
+
 	// Initialize the dictionary headers
 
 	word *last = NULL;
@@ -1206,15 +4686,38 @@ main(int argc, char *argv[], char *env[])
 	cp = code;
 
 	// Initialize virtual machine
+vm_init:
 
-	memset(ds, 0, sizeof(ds));
+	memset(ds0, 0, sizeof(ds0));
+	if (self && self->ds)
+		ds = self->ds;
 	dsp = ds+3;
 	rsp = rs+3;
 	asp = as+3;
 	lsp = ls+3;
+
+	task_main.ds = ds;
+	task_main.rs = rs0;
+	task_main.as = as0;
+	task_main.ls = ls0;
+	task_main.room = STACK;
 	ip = init;
 
-	char *fsrc = strdup(src_base);
+	if (!boot)
+	{
+		ip = self->start;
+		cp = self->cp;
+		hp = self->hp;
+		tos = self->result; // argument
+		if (self->dsp)
+		{
+			dsp = self->dsp;
+			tos = dpop;
+		}
+		goto vm_ready;
+	}
+
+	fsrc = strdup(src_base);
 
 #ifdef TURNKEY
 
@@ -1243,6 +4746,8 @@ main(int argc, char *argv[], char *env[])
 	// First word called is always EVALUATE, so place source address TOS
 	tos = (cell)fsrc;
 
+vm_ready:
+
 	// Start code word labels
 
 	// These *must* come before the first INEXT executes because CODE
@@ -1994,11 +5499,13 @@ main(int argc, char *argv[], char *env[])
 	CODE(EMIT)
 		c = tos;
 		tos = dpop;
-		write(fileno(stdout_current), &c, 1);
+		out_write(out_current, &c, 1);
 	NEXT
 
 	// ( -- c )
 	CODE(KEY)
+		if (task_input(in_current, 0))
+			goto task_block;
 		dpush(tos);
 		tos = key();
 	NEXT
@@ -2009,6 +5516,23 @@ main(int argc, char *argv[], char *env[])
 		tos = keyq();
 	NEXT
 
+	// ( buf lim -- len f )
+	CODE(READ_LINE)
+		if (task_input(in_current, 1))
+			goto task_block;
+		charp = (char*)dpop;
+		tos = in_line(in_current, charp, tos, &num);
+		dpush(num);
+	NEXT
+
+	// ( buf n -- len )
+	CODE(READ_BYTES)
+		if (task_input(in_current, 0))
+			goto task_block;
+		charp = (char*)dpop;
+		tos = tos > 0 ? in_bytes(in_current, charp, tos): 0;
+	NEXT
+
 	// ( -- a )
 	CODE(GETENV)
 		tos = (cell)getenv((char*)tos);
@@ -2063,22 +5587,373 @@ main(int argc, char *argv[], char *env[])
 		tos = dpop;
 	NEXT
 
+	// ( a -- ) set up a vector at a
+	CODE(VEC_INIT)
+		vec_init((vector*)tos);
+		tos = dpop;
+	NEXT
+
+	// ( a -- ) free a vector's data, not a itself
+	CODE(VEC_RELEASE)
+		free(((vector*)tos)->data);
+		tos = dpop;
+	NEXT
+
+	// ( n v -- )
+	CODE(VEC_PUSH)
+		voidp = (void*)tos;
+		if (((vector*)voidp)->size == ((vector*)voidp)->room)
+			vec_reserve(voidp, ((vector*)voidp)->size+1);
+		((vector*)voidp)->data[((vector*)voidp)->size++] = dpop;
+		tos = dpop;
+	NEXT
+
+	// ( v -- n ) 0 when empty
+	CODE(VEC_POP)
+		voidp = (void*)tos;
+		tos = ((vector*)voidp)->size ? ((vector*)voidp)->data[--((vector*)voidp)->size]: 0;
+	NEXT
+
+	// ( v -- n ) 0 when empty
+	CODE(VEC_TOP)
+		voidp = (void*)tos;
+		tos = ((vector*)voidp)->size ? ((vector*)voidp)->data[((vector*)voidp)->size-1]: 0;
+	NEXT
+
+	// ( i v -- n ) i clamped to the vector, 0 when empty
+	CODE(VEC_GET)
+		voidp = (void*)tos;
+		tmp = dpop;
+		num = ((vector*)voidp)->size;
+		tos = num ? ((vector*)voidp)->data[tmp < 0 ? 0: tmp < num ? tmp: num-1]: 0;
+	NEXT
+
+	// ( i v -- n ) unchecked
+	CODE(VEC_FETCH)
+		tos = ((vector*)tos)->data[dpop];
+	NEXT
+
+	// ( n i v -- ) unchecked
+	CODE(VEC_STORE)
+		tmp = dpop;
+		((vector*)tos)->data[tmp] = dpop;
+		tos = dpop;
+	NEXT
+
+	// ( a n v -- ) push n cells from a
+	CODE(VEC_APPEND)
+		voidp = (void*)tos;
+		num = dpop;
+		cellp = (cell*)dpop;
+		if (num > 0)
+		{
+			// a may lie within the vector, which can move
+			tmp = cellp - ((vector*)voidp)->data;
+			vec_reserve(voidp, ((vector*)voidp)->size + num);
+			if (tmp >= 0 && tmp < ((vector*)voidp)->size)
+				cellp = ((vector*)voidp)->data + tmp;
+			memmove(((vector*)voidp)->data + ((vector*)voidp)->size, cellp, sizeof(cell) * num);
+			((vector*)voidp)->size += num;
+		}
+		tos = dpop;
+	NEXT
+
+	// ( n v -- ) drop all but the first n cells
+	CODE(VEC_TRUNCATE)
+		voidp = (void*)tos;
+		tmp = dpop;
+		if (tmp >= 0 && tmp < ((vector*)voidp)->size)
+			((vector*)voidp)->size = tmp;
+		tos = dpop;
+	NEXT
+
+	// ( n ints -- m ) room for about n keys, integers if ints else strings
+	CODE(MAP_NEW)
+		tos = (cell)map_new(dpop, tos);
+	NEXT
+
+	// ( m -- )
+	CODE(MAP_FREE)
+		map_free((map*)tos);
+		tos = dpop;
+	NEXT
+
+	// ( value key m -- )
+	CODE(MAP_SET)
+		tmp = dpop;
+		map_set((map*)tos, tmp, dpop);
+		tos = dpop;
+	NEXT
+
+	// ( key m -- value ) 0 when absent
+	CODE(MAP_GET)
+		voidp = map_find((map*)tos, dpop);
+		tos = voidp ? ((map_slot*)voidp)->value: 0;
+	NEXT
+
+	// ( key m -- f )
+	CODE(MAP_EXISTS)
+		tos = map_find((map*)tos, dpop) ? -1: 0;
+	NEXT
+
+	// ( key m -- value ) 0 when absent
+	CODE(MAP_REMOVE)
+		tos = map_remove((map*)tos, dpop);
+	NEXT
+
+	// ( m -- n )
+	CODE(MAP_COUNT)
+		tos = ((map*)tos)->count;
+	NEXT
+
+	// ( xt m -- ) xt ( key value -- ) for each entry, which must not
+	// change the map
+	CODE(MAP_EACH)
+		*asp++ = dpop;
+		*asp++ = tos;
+		*asp++ = 0;
+		tos = dpop;
+		while ((voidp = map_slot_at((map*)asp[-2], &asp[-1])))
+		{
+			asp[-1]++;
+			dpush(tos);
+			dpush(((map_slot*)voidp)->key);
+			tos = ((map_slot*)voidp)->value;
+			IEXECUTE(asp[-3], map_each)
+		}
+		asp -= 3;
+	NEXT
+
+	// ( xt a n -- ) sort n cells at a by xt ( x y -- f ), true when x
+	// goes before y; no promise of stability
+	CODE(SORT)
+		goto code_MSORT;
+	NEXT
+
+	// ( xt a n -- ) stable sort
+	CODE(MSORT)
+		num = tos;
+		cellp = (cell*)dpop;
+		xt1 = dpop;
+		tos = dpop;
+		if ((i = sort_native(xt1)))
+		{
+			sort_cells(cellp, num);
+			for (j = 0; i < 0 && j < num/2; j++)
+			{
+				tmp = cellp[j];
+				cellp[j] = cellp[num-1-j];
+				cellp[num-1-j] = tmp;
+			}
+		}
+		else
+		{
+			*asp++ = xt1;
+			*asp++ = (cell)msort_new(cellp, num);
+			while (msort_next((msorter*)asp[-1], &tmp, &num))
+			{
+				dpush(tos);
+				dpush(tmp);
+				tos = num;
+				IEXECUTE(asp[-2], msort)
+				msort_take((msorter*)asp[-1], tos);
+				tos = dpop;
+			}
+			free((void*)asp[-1]);
+			asp -= 2;
+		}
+	NEXT
+
+	// ( a n -- ) sort n signed cells ascending
+	CODE(SORT_CELLS)
+		sort_cells((cell*)dpop, tos);
+		tos = dpop;
+	NEXT
+
+	// ( a n -- ) sort n C string pointers ascending
+	CODE(SORT_STRINGS)
+		num = tos;
+		qsort((void*)dpop, num > 0 ? num: 0, sizeof(cell), sort_strcmp);
+		tos = dpop;
+	NEXT
+
 	// ( name -- a )
 	CODE(SLURP)
 		tos = (cell)slurp((char*)tos);
 	NEXT
 
+	// ( name -- a n )
+	CODE(MAPFILE)
+		tos = (cell)map_file((char*)tos, &num);
+		dpush(tos);
+		tos = num;
+	NEXT
+
+	// ( a n -- )
+	CODE(UNMAPFILE)
+		unmap_file((char*)dpop, tos);
+		tos = dpop;
+	NEXT
+
 	// ( a name -- f )
 	CODE(BLURT)
 		charp = (char*)dpop;
 		tos = (cell)blurt((char*)tos, charp, strlen(charp));
 	NEXT
 
-	// ( ... a -- b )
-	CODE(FORMAT)
-		cellp = dsp;
-		tos = (cell)format((char*)tos, &cellp);
-		dsp = cellp;
+	// ( a name -- f )
+	CODE(BLURT_ATOMIC)
+		charp = (char*)dpop;
+		tos = (cell)blurt_atomic((char*)tos, charp, strlen(charp));
+	NEXT
+
+	// ( path -- f )
+	CODE(SEND_FILE)
+		tos = send_file((char*)tos) ? -1: 0;
+	NEXT
+
+	// ( buf len -- req )
+	CODE(PARSE_REQUEST)
+		tos = (cell)request_parse((char*)dpop, tos);
+	NEXT
+
+	// ( req -- a n )
+	CODE(REQ_METHOD)
+		dpush(tos ? (cell)((request*)tos)->method.a: 0);
+		tos = tos ? ((request*)tos)->method.n: 0;
+	NEXT
+
+	// ( req -- a n )
+	CODE(REQ_PATH)
+		dpush(tos ? (cell)((request*)tos)->path.a: 0);
+		tos = tos ? ((request*)tos)->path.n: 0;
+	NEXT
+
+	// ( req -- a n )
+	CODE(REQ_QUERY)
+		dpush(tos ? (cell)((request*)tos)->query.a: 0);
+		tos = tos ? ((request*)tos)->query.n: 0;
+	NEXT
+
+	// ( req -- a n )
+	CODE(REQ_VERSION)
+		dpush(tos ? (cell)((request*)tos)->version.a: 0);
+		tos = tos ? ((request*)tos)->version.n: 0;
+	NEXT
+
+	// ( req -- a n )
+	CODE(REQ_BODY)
+		dpush(tos ? (cell)((request*)tos)->body.a: 0);
+		tos = tos ? ((request*)tos)->body.n: 0;
+	NEXT
+
+	// ( name req -- a n )
+	CODE(REQ_HEADER)
+		charp = (char*)dpop;
+		voidp = tos && charp ? request_header((request*)tos, charp, strlen(charp)): NULL;
+		dpush(voidp ? (cell)((slice*)voidp)->a: 0);
+		tos = voidp ? ((slice*)voidp)->n: 0;
+	NEXT
+
+	// ( pattern xt -- )
+	CODE(ROUTE)
+		route_add((char*)dpop, tos);
+		tos = dpop;
+	NEXT
+
+	// ( uri -- f )
+	CODE(DISPATCH)
+		tmp = tos ? route_find((char*)tos): 0;
+		tos = dpop;
+		if (tmp)
+		{
+			IEXECUTE(tmp, dispatch)
+			tmp = -1;
+		}
+		dpush(tos);
+		tos = tmp;
+	NEXT
+
+	// ( name -- a )
+	CODE(ROUTE_PARAM)
+		tos = tos ? (cell)route_param((char*)tos): 0;
+	NEXT
+
+	// ( name mode -- fh )
+	CODE(OPEN_FILE)
+		tos = (cell)file_open((char*)dpop, (char*)tos);
+	NEXT
+
+	// ( fh -- f )
+	CODE(CLOSE_FILE)
+		tos = tos ? file_close((file*)tos): 0;
+	NEXT
+
+	// ( buf n fh -- len )
+	CODE(READ_FILE)
+		if (tos && (out_flush(&((file*)tos)->out), task_input(&((file*)tos)->in, 0)))
+			goto task_block;
+		num = dpop;
+		charp = (char*)dpop;
+		tos = tos && num > 0 ? file_read((file*)tos, charp, num): 0;
+	NEXT
+
+	// ( buf lim fh -- len f )
+	CODE(READ_FILE_LINE)
+		if (tos && (out_flush(&((file*)tos)->out), task_input(&((file*)tos)->in, 1)))
+			goto task_block;
+		num = dpop;
+		charp = (char*)dpop;
+		if (tos)
+			tos = file_line((file*)tos, charp, num, &num);
+		else
+			num = 0;
+		dpush(num);
+	NEXT
+
+	// ( buf n fh -- f )
+	CODE(WRITE_FILE)
+		num = dpop;
+		charp = (char*)dpop;
+		tos = !tos ? 0: num > 0 ? (file_write((file*)tos, charp, num) ? -1:0): -1;
+	NEXT
+
+	// ( pos fh -- f )
+	CODE(SEEK_FILE)
+		tmp = dpop;
+		tos = tos ? file_seek((file*)tos, tmp): 0;
+	NEXT
+
+	// ( fh -- n )
+	CODE(FILE_SIZE)
+		tos = tos ? file_size((file*)tos): -1;
+	NEXT
+
+	// ( ... a -- b )
+	CODE(FORMAT)
+		cellp = dsp;
+		tos = (cell)format((char*)tos, &cellp);
+		dsp = cellp;
+	NEXT
+
+	// ( ... a level -- )
+	CODE(LOG_LINE)
+		charp = (char*)dpop;
+		cellp = dsp;
+		log_line(charp, tos, &cellp);
+		dsp = cellp;
+		tos = dpop;
+	NEXT
+
+	// ( -- a )
+	CODE(LOG_LEVEL)
+		dpush(tos);
+		tos = (cell)&logs.level;
+	NEXT
+
+	// ( -- )
+	CODE(LOG_FLUSH)
+		log_flush();
 	NEXT
 
 	// ( name a -- xt )
@@ -2104,6 +5979,190 @@ main(int argc, char *argv[], char *env[])
 		tos = dsp-ds-3;
 	NEXT
 
+	// ( xt -- h )
+	CODE(THREAD)
+		out_flush_all();
+		voidp = calloc(1, sizeof(thread));
+		((thread*)voidp)->start[0] = tos;
+		((thread*)voidp)->start[1] = DIE;
+		((thread*)voidp)->cp = cp;
+		((thread*)voidp)->hp = hp;
+		if (pthread_create(&((thread*)voidp)->id, NULL, thread_main, voidp) != 0)
+		{
+			free(voidp);
+			voidp = NULL;
+		}
+		tos = (cell)voidp;
+	NEXT
+
+	// ( h -- x )
+	CODE(THREAD_JOIN)
+		if (tos)
+		{
+			voidp = (void*)tos;
+			pthread_join(((thread*)voidp)->id, NULL);
+			tos = ((thread*)voidp)->result;
+			free(voidp);
+		}
+	NEXT
+
+#ifdef EMBED
+	// ( ... -- ... ) a host function, see rf_define
+	CODE(HOST)
+		dpush(tos);
+		self->ds = ds;
+		self->dsp = dsp;
+		((rf_host)body[xt])((rf_vm*)self);
+		dsp = self->dsp;
+		tos = dpop;
+	NEXT
+#endif
+
+	// ( n xt -- ) run xt for each I in 0..n-1, in parallel
+	CODE(PFOR)
+		out_flush_all();
+		voidp = pfor_begin(dpop, tos, 0, 0, cp, hp);
+		tos = dpop;
+		j = 0;
+
+	pfor_run:
+		// Worker j of job voidp. Calls into Forth clobber C locals, so
+		// keep job, worker, next index and chunk limit on the alternate
+		// stack, and the index in a loop frame where I finds it
+		asp[0] = (cell)voidp;
+		asp[1] = j;
+		asp[2] = 0;
+		asp[3] = 0;
+		asp += 4;
+		lsp += LSP_NEST;
+		lsp[LSP_LIM] = 0;
+		lsp[LSP_IP] = 0;
+
+	pfor_next:
+		voidp = (void*)asp[-4];
+		if (asp[-2] == asp[-1] && !pfor_take(voidp, asp[-3], &asp[-2], &asp[-1]))
+			goto pfor_done;
+		lsp[LSP_IDX] = asp[-2]++;
+		if (((pfor_job*)voidp)->op)
+		{
+			dpush(tos);
+			tos = ((pfor_job*)voidp)->slices[asp[-3]].acc;
+			IEXECUTE(((pfor_job*)voidp)->xt, pfor_fold)
+			((pfor_job*)asp[-4])->slices[asp[-3]].acc = tos;
+			tos = dpop;
+		}
+		else
+		{
+			IEXECUTE(((pfor_job*)voidp)->xt, pfor)
+		}
+		goto pfor_next;
+
+	pfor_done:
+		lsp -= LSP_NEST;
+		asp -= 4;
+		voidp = (void*)asp[0];
+		pfor_end(voidp, asp[1]);
+		if ((j = asp[1]))
+			goto pool_wait;
+
+		if (((pfor_job*)voidp)->op)
+		{
+			// combine the workers' partial results
+			dpush(tos);
+			tos = ((pfor_job*)voidp)->slices[0].acc;
+			*asp++ = (cell)voidp;
+			*asp++ = 1;
+			while (asp[-1] < ((pfor_job*)asp[-2])->workers)
+			{
+				voidp = (void*)asp[-2];
+				dpush(tos);
+				tos = ((pfor_job*)voidp)->slices[asp[-1]++].acc;
+				IEXECUTE(((pfor_job*)voidp)->op, pfor_combine)
+			}
+			asp -= 2;
+			voidp = (void*)asp[0];
+		}
+		pfor_free(voidp);
+	NEXT
+
+	// ( acc n xt op -- acc' ) xt ( acc -- acc' ) folds in each I, from
+	// acc per worker, and op ( a b -- c ) combines the results, so acc
+	// must be an identity for op (eg, 0 with +)
+	CODE(PREDUCE)
+		out_flush_all();
+		xt1 = dpop;
+		tmp = dpop;
+		voidp = pfor_begin(tmp, xt1, tos, dpop, cp, hp);
+		tos = dpop;
+		j = 0;
+		goto pfor_run;
+	NEXT
+
+	// ( w -- ) pool thread w, for good
+	CODE(PFOR_WORK)
+		j = tos;
+	pool_wait:
+		voidp = pfor_wait();
+		goto pfor_run;
+	NEXT
+
+	// ( xt -- t )
+	CODE(TASK)
+		tos = (cell)task_new(tos, TASK_END);
+	NEXT
+
+	// ( -- )
+	CODE(YIELD)
+		if (tasks_other())
+			goto task_switch;
+	NEXT
+
+	// ( t -- )
+	CODE(RESUME)
+		tp = (task*)tos;
+		tos = dpop;
+		if (tp && tp != task_current && tp->state == TASK_READY)
+			goto task_load;
+	NEXT
+
+	// ( t -- x )
+	CODE(JOIN)
+		tp = (task*)tos;
+		// neither could ever end while we wait
+		if (tp)
+			ensure(tp != task_current && tp != &task_main)
+				errorf("join: a task cannot join itself or the main task");
+		if (tp && tp->state != TASK_DONE)
+		{
+			// sleep until it ends, then run JOIN again
+			tp->joiner = task_current;
+			task_current->state = TASK_JOIN;
+			goto task_block;
+		}
+		if (tp)
+		{
+			tos = tp->result;
+			task_free(tp);
+		}
+	NEXT
+
+	// ( x -- )
+	CODE(TASK_END)
+		task_current->result = tos;
+		task_current->state = TASK_DONE;
+		if (task_current->joiner)
+			task_current->joiner->state = TASK_READY;
+		goto task_switch;
+	NEXT
+
+#ifdef TASK_BUDGET
+	// ( -- a )
+	CODE(TASK_BUDGET_W)
+		dpush(tos);
+		tos = (cell)&task_budget;
+	NEXT
+#endif
+
 	// ( -- a )
 	CODE(HERE)
 		dpush(tos);
@@ -2124,6 +6183,7 @@ main(int argc, char *argv[], char *env[])
 
 	// ( n -- )
 	CODE(ALLOT)
+		dict_check();
 		ensure(cp + tos < code + CODESPACE)
 			errorf("dictionary overflow");
 		memset(cp, 0, tos);
@@ -2141,6 +6201,7 @@ main(int argc, char *argv[], char *env[])
 
 	// ( c -- )
 	CODE(CCOMMA)
+		dict_check();
 		ensure(cp + 1 < code + CODESPACE)
 			errorf("dictionary overflow");
 		*((char*)cp) = tos;
@@ -2387,18 +6448,47 @@ main(int argc, char *argv[], char *env[])
 	// ( a -- )
 	CODE(TYPE)
 		if (tos)
-			write(fileno(stdout_current), (char*)tos, strlen((char*)tos));
+			out_write(out_current, (char*)tos, strlen((char*)tos));
+		tos = dpop;
+	NEXT
+
+	// ( a -- )
+	CODE(TYPE_HTML)
+		if (tos)
+			out_html(out_current, (char*)tos);
 		tos = dpop;
 	NEXT
 
 	// ( a -- )
 	CODE(ERROR)
-		write(fileno(stderr), (char*)tos, strlen((char*)tos));
+		// keep pending log lines ahead of it
+		log_flush();
+		if (tos)
+			out_write(&out_err, (char*)tos, strlen((char*)tos));
 		tos = dpop;
 	NEXT
 
+	// ( -- )
+	CODE(FLUSH)
+		out_flush_all();
+	NEXT
+
+	// ( -- a )
+	CODE(LINE_OUTPUT)
+		dpush(tos);
+		tos = (cell)&out_std.lines;
+	NEXT
+
 	// ( n -- )
 	CODE(USEC)
+		out_flush_all();
+		if (tasks_other())
+		{
+			// sleep by letting the other tasks run
+			task_park(-1, 0, tos > 0 ? tos: 1);
+			tos = dpop;
+			goto task_switch;
+		}
 		usleep(tos);
 		tos = dpop;
 	NEXT
@@ -2473,7 +6563,16 @@ main(int argc, char *argv[], char *env[])
 		{
 			stdin_current = fopen("/dev/tty", "r");
 			stdout_current = fopen("/dev/tty", "w");
-			write(fileno(stdout_current), "\e[?1049h", 8);
+			in_tty.fd = fileno(stdin_current);
+			in_tty.tied = 1;
+			in_tty.pos = in_tty.len = 0;
+			in_current = &in_tty;
+			out_flush(&out_std);
+			out_std.fd = fileno(stdout_current);
+			// full-screen programs redraw then wait on KEY, which flushes
+			pty_lines = out_std.lines;
+			out_std.lines = 0;
+			out_write(&out_std, "\e[?1049h", 8);
 			pty_state = 1;
 		}
 	NEXT
@@ -2489,11 +6588,15 @@ main(int argc, char *argv[], char *env[])
 	CODE(PTY_OFF)
 		if (pty_state)
 		{
-			write(fileno(stdout_current), "\e[?1049l", 8);
+			out_write(&out_std, "\e[?1049l", 8);
+			out_flush(&out_std);
 			fclose(stdin_current);
 			fclose(stdout_current);
 			stdin_current = stdin;
 			stdout_current = stdout;
+			in_current = &in_std;
+			out_std.fd = fileno(stdout_current);
+			out_std.lines = pty_lines;
 			pty_state = 0;
 		}
 	NEXT
@@ -2523,9 +6626,12 @@ main(int argc, char *argv[], char *env[])
 	// ( -- )
 	CODE(FORK)
 		signal(SIGCHLD, catch_exit);
+		out_flush_all();
 		if (!fork())
 		{
 			setsid();
+			if (task_current)
+				task_current->next = task_current->prev = task_current;
 			init[0] = BYE;
 			ip = init;
 			xt = tos;
@@ -2538,6 +6644,55 @@ main(int argc, char *argv[], char *env[])
 		tos = dpop;
 	NEXT
 
+	// ( xt a n workers -- f ) replace each of n cells at a, which should
+	// be SHM-ALLOCATEd, with xt ( x -- x' ) run in forked workers; false
+	// if any worker failed
+	CODE(FORK_MAP)
+		signal(SIGCHLD, catch_exit);
+		sigchld_hold();
+		out_flush_all();
+		i = tos;
+		num = dpop;
+		*asp++ = dpop; // a
+		*asp++ = dpop; // xt
+		tos = dpop;
+		asp += 3;
+		asp[-1] = (cell)fork_slices(num, i, &asp[-3], &asp[-2]);
+		lsp += LSP_NEST;
+		lsp[LSP_LIM] = 0;
+		lsp[LSP_IP] = 0;
+		while (asp[-3] < asp[-2])
+		{
+			lsp[LSP_IDX] = asp[-3];
+			dpush(tos);
+			tos = ((cell*)asp[-5])[asp[-3]];
+			IEXECUTE(asp[-4], fork_map)
+			((cell*)asp[-5])[asp[-3]++] = tos;
+			tos = dpop;
+		}
+		lsp -= LSP_NEST;
+		if (!asp[-1])
+		{
+			out_flush_all();
+			_exit(0);
+		}
+		dpush(tos);
+		tos = fork_wait((pid_t*)asp[-1]) ? -1: 0;
+		sigchld_release();
+		asp -= 5;
+	NEXT
+
+	// ( n -- a )
+	CODE(SHM_ALLOCATE)
+		tos = (cell)shm_allocate(tos);
+	NEXT
+
+	// ( a -- )
+	CODE(SHM_FREE)
+		shm_free((void*)tos);
+		tos = dpop;
+	NEXT
+
 	// ( -- pid )
 	CODE(SELF)
 		dpush(tos);
@@ -2550,6 +6705,170 @@ main(int argc, char *argv[], char *env[])
 		tos = (cell)sys_exec((char*)tos, tmp ? (char*)tmp: "");
 	NEXT
 
+	// ( data cmd xt -- status )
+	CODE(SYSTEM_STREAM)
+		// xt and pump live on the alternate stack while xt runs
+		*asp++ = tos;
+		charp = (char*)dpop;
+		*asp++ = (cell)pump_open(charp, (char*)dpop);
+		tos = dpop;
+		while (asp[-1] && (num = pump_read((pump*)asp[-1], ((pump*)asp[-1])->buf, PUMP_BUF-1)) > 0)
+		{
+			charp = ((pump*)asp[-1])->buf;
+			charp[num] = 0;
+			dpush(tos);
+			dpush((cell)charp);
+			tos = num;
+			IEXECUTE(asp[-2], system_stream)
+		}
+		dpush(tos);
+		tos = asp[-1] ? pump_close((pump*)asp[-1]): -1;
+		asp -= 2;
+	NEXT
+
+	// ( cmds n jobs -- results )
+	CODE(SYSTEM_ALL)
+		num = dpop;
+		tos = (cell)sys_exec_all((char**)dpop, num, tos);
+	NEXT
+
+	// ( argv -- pid in out )
+	CODE(SPAWN)
+		// listed for WAIT-PID before SIGCHLD can reap it
+		sigchld_hold();
+		tmp = spawn_io(((char**)tos)[0], (char**)tos, &i, &j);
+		if (tmp >= 0)
+			spawn_track(tmp);
+		sigchld_release();
+		if (tmp < 0)
+		{
+			tos = 0;
+			dpush(-1);
+			dpush(0);
+		}
+		else
+		{
+			dpush(tmp);
+			dpush((cell)file_fd(i));
+			((file*)dsp[-1])->out.quiet = 1;
+			tos = (cell)file_fd(j);
+		}
+	NEXT
+
+	// ( cmd -- handle )
+	CODE(COPROC)
+		tos = (cell)coproc_open((char*)tos);
+	NEXT
+
+	// ( a handle -- f )
+	CODE(COPROC_SEND)
+		charp = (char*)dpop;
+		tos = tos && charp ? coproc_send((coproc*)tos, charp): 0;
+	NEXT
+
+	// ( buf lim handle -- len f )
+	CODE(COPROC_RECV_LINE)
+		if (tos && (out_flush(&((coproc*)tos)->to->out), task_input(&((coproc*)tos)->from->in, 1)))
+			goto task_block;
+		tmp = dpop;
+		charp = (char*)dpop;
+		num = 0;
+		tos = tos ? coproc_recv_line((coproc*)tos, charp, tmp, &num): 0;
+		dpush(num);
+	NEXT
+
+	// ( a buf lim handle -- len f )
+	CODE(COPROC_ASK)
+		tmp = dpop;
+		charp = (char*)dpop;
+		num = 0;
+		if (tos)
+			tos = coproc_ask((coproc*)tos, (char*)dpop, charp, tmp, &num);
+		else
+			dsp--;
+		dpush(num);
+	NEXT
+
+	// ( handle -- status )
+	CODE(COPROC_CLOSE)
+		tos = tos ? coproc_close((coproc*)tos): -1;
+	NEXT
+
+	// ( pid -- status )
+	CODE(WAIT_PID)
+		if (tos > 0)
+			tos = spawn_wait(tos);
+	NEXT
+
+#endif
+
+#ifdef LIB_SERVE
+
+	// ( port xt -- )
+	CODE(SERVE)
+		i = 0;
+	serve_start:
+		// whether this is a prefork worker, xt and server live on the
+		// alternate stack while xt runs
+		*asp++ = i;
+		*asp++ = tos;
+		*asp++ = (cell)server_open(dpop, i);
+		tos = dpop;
+		while (asp[-1] && server_next((server*)asp[-1]))
+		{
+			if (server_cached((server*)asp[-1]))
+				continue;
+			IEXECUTE(asp[-2], serve)
+			server_respond((server*)asp[-1]);
+		}
+		// a worker must not go on to run the rest of the parent's script
+		if (asp[-3])
+			exit(asp[-1] ? EXIT_SUCCESS: EXIT_FAILURE);
+		asp -= 3;
+	NEXT
+
+	// ( port workers xt -- )
+	CODE(SERVE_PREFORK)
+		// each worker listens on its own SO_REUSEPORT socket
+		if (prefork(dpop))
+		{
+			i = 1;
+			goto serve_start;
+		}
+		dsp--;
+		tos = dpop;
+	NEXT
+
+	// ( paths conns total port -- stats )
+	CODE(HTTP_LOAD)
+		num = dpop;
+		tmp = dpop;
+		tos = (cell)http_load((char*)dpop, tmp, num, tos);
+	NEXT
+
+	// ( ttl -- )
+	CODE(CACHE_PAGE)
+		// cache this request's response for ttl seconds
+		cache.ttl = tos;
+		tos = dpop;
+	NEXT
+
+	// ( names -- )
+	CODE(CACHE_VARY)
+		// space separated headers that also key cached responses
+		free(cache.vary);
+		cache.vary = tos ? strdup((char*)tos): NULL;
+		tos = dpop;
+	NEXT
+
+	// ( -- hits misses bytes )
+	CODE(CACHE_STATS)
+		dpush(tos);
+		dpush(cache.hits);
+		dpush(cache.misses);
+		tos = cache.bytes;
+	NEXT
+
 #endif
 
 	CODE(EVALUATE)
@@ -2768,6 +7087,7 @@ main(int argc, char *argv[], char *env[])
 	next:
 		if (dsp < ds+2)
 		{
+			out_flush_all();
 			fprintf(stderr, "stack underflow");
 			fprintf(stderr, "\n%s", head[*ip].name);
 			exit(EXIT_FAILURE);
@@ -2775,6 +7095,7 @@ main(int argc, char *argv[], char *env[])
 		if (single)
 		{
 			// single step debugger
+			out_flush_all();
 			fprintf(stderr, "\nD: %lld ", (long long)tos);
 			for (i = -1; dsp+i+1 > ds+3 && i > -10; i--)
 				fprintf(stderr, "%lld ", (long long)dsp[i]);
@@ -2786,6 +7107,56 @@ main(int argc, char *argv[], char *env[])
 		}
 #endif
 
+	// Task switching. A word that would block jumps to task_block to
+	// run again when the task resumes; task_switch carries on after it.
+	if (0)
+	{
+		task_block:
+			task_current->redo = xt;
+
+		task_switch:
+			ensure((tp = task_pick()))
+				errorf("task: deadlock, every task is waiting");
+
+		task_load:
+			ensure(dsp < ds + task_current->room && rsp < rs + task_current->room
+				&& asp < as + task_current->room && lsp < ls + task_current->room)
+					errorf("task: stack overflow");
+			task_current->ip = ip;
+			task_current->tos = tos;
+			task_current->dsp = dsp;
+			task_current->rsp = rsp;
+			task_current->asp = asp;
+			task_current->lsp = lsp;
+			if (task_current->state == TASK_DONE)
+				task_unlink(task_current);
+			task_current = tp;
+			ds = tp->ds;
+			rs = tp->rs;
+			as = tp->as;
+			ls = tp->ls;
+			ip = tp->ip;
+			tos = tp->tos;
+			dsp = tp->dsp;
+			rsp = tp->rsp;
+			asp = tp->asp;
+			lsp = tp->lsp;
+			if ((xt = tp->redo))
+			{
+				tp->redo = 0;
+				goto *call[xt];
+			}
+			INEXT
+
+#ifdef TASK_BUDGET
+		task_tick:
+			task_ticks = task_budget;
+			if (tasks_other())
+				goto task_switch;
+			INEXT
+#endif
+	}
+
 	// Finally, jump into Forth!
 	INEXT
 
@@ -2797,9 +7168,187 @@ main(int argc, char *argv[], char *env[])
 		}
 		if (pty_state)
 		{
-			write(fileno(stdout_current), "\e[?1049l", 8);
+			out_write(&out_std, "\e[?1049l", 8);
+		}
+		out_flush_all();
+
+	if (self)
+	{
+		// definitions, and an embedded VM's stack, outlive the call
+		self->cp = cp;
+		self->hp = hp;
+		if (self->ds)
+		{
+			dpush(tos);
+			self->dsp = dsp;
 		}
+	}
 
 	free(fsrc);
 	return tos;
 }
+
+#ifdef EMBED
+
+// The embedding API, see reforth.h. Every VM runs over one dictionary,
+// booted with base.fs on first use, so words defined in one are visible
+// to all. Calls on different VMs may run on different threads at once,
+// under the same rule as THREAD: only while none of them defines words.
+
+struct rf_vm {
+	thread t;
+	cell stack[STACK];
+};
+
+struct {
+	tok *cp;
+	word *hp;
+} rf_dict;
+
+pthread_once_t rf_booted = PTHREAD_ONCE_INIT;
+
+void
+rf_boot()
+{
+	thread t = { .start = { BYE } };
+	forth(0, NULL, &t);
+	rf_dict.cp = t.cp;
+	rf_dict.hp = t.hp;
+}
+
+rf_vm*
+rf_vm_new()
+{
+	pthread_once(&rf_booted, rf_boot);
+	rf_vm *vm = calloc(1, sizeof(rf_vm));
+	if (vm)
+	{
+		vm->t.ds = vm->stack;
+		vm->t.dsp = vm->stack+4;
+	}
+	return vm;
+}
+
+void
+rf_vm_free(rf_vm *vm)
+{
+	free(vm);
+}
+
+// Run the VM's start program. A failed ensure(), or a false flag left by
+// a checked call, lands in one recovery that puts back the stack as it
+// was, less n arguments, and forgets any half-made definition
+int
+rf_run(rf_vm *vm, int n, int checked)
+{
+	jmp_buf fail, *outer = rf_fail;
+	cell *dsp = vm->t.dsp - n;
+	cell saved[dsp - vm->stack];
+	memcpy(saved, vm->stack, sizeof(saved));
+
+	word *words = normal, *macros = macro, **wordlist = current;
+	tok *cp = vm->t.cp = rf_dict.cp;
+	word *hp = vm->t.hp = rf_dict.hp;
+
+	int failed = setjmp(fail);
+	if (!failed)
+	{
+		rf_fail = &fail;
+		forth(0, NULL, &vm->t);
+		failed = checked && !rf_pop(vm);
+	}
+	rf_fail = outer;
+
+	if (failed)
+	{
+		// the abandoned call never reached shutdown's flush
+		out_flush(out_current);
+		out_flush_all();
+		memcpy(vm->stack, saved, sizeof(saved));
+		vm->t.dsp = dsp;
+		for (word *w = normal; w >= hp; w = w->prev)
+			free(w->name);
+		for (word *w = macro; w >= hp; w = w->prev)
+			free(w->name);
+		normal = words;
+		macro = macros;
+		current = wordlist;
+		mode = 0;
+		return -1;
+	}
+	// only calls that define words touch the shared pointers
+	if (vm->t.cp != cp)
+		rf_dict.cp = vm->t.cp;
+	if (vm->t.hp != hp)
+		rf_dict.hp = vm->t.hp;
+	return 0;
+}
+
+int
+rf_eval(rf_vm *vm, const char *src)
+{
+	char *s = strdup(src);
+	vm->t.start[0] = EVALUATE;
+	vm->t.start[1] = DIE;
+	rf_push(vm, (long)s);
+	// EVALUATE leaves false on an unknown word, perhaps mid definition
+	int r = rf_run(vm, 1, 1);
+	free(s);
+	return r;
+}
+
+int
+rf_call(rf_vm *vm, const char *name)
+{
+	tok xt = find(normal, (char*)name);
+	if (!xt)
+		return -1;
+	vm->t.start[0] = xt;
+	vm->t.start[1] = DIE;
+	return rf_run(vm, 0, 0);
+}
+
+void
+rf_push(rf_vm *vm, long n)
+{
+	if (vm->t.dsp < vm->t.ds + STACK)
+		*vm->t.dsp++ = n;
+}
+
+long
+rf_pop(rf_vm *vm)
+{
+	return vm->t.dsp > vm->t.ds+4 ? *--vm->t.dsp: 0;
+}
+
+int
+rf_depth(rf_vm *vm)
+{
+	return vm->t.dsp - vm->t.ds - 4;
+}
+
+int
+rf_define(const char *name, rf_host fn)
+{
+	pthread_once(&rf_booted, rf_boot);
+	if (rf_dict.hp - head >= MAXTOKEN)
+		return -1;
+	word *w = rf_dict.hp++;
+	w->name = strdup(name);
+	w->prev = normal;
+	w->subs = w;
+	normal = w;
+	call[w-head] = call[HOST];
+	body[w-head] = (tok*)fn;
+	return 0;
+}
+
+#else
+
+int
+main(int argc, char *argv[], char *env[])
+{
+	return forth(argc, argv, NULL);
+}
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * Reforth embedding API, for libreforth (make library).
+ *
+ * The system boots from base.fs once per process, on the first rf_vm_new()
+ * or rf_define(). Each VM has its own data stack, kept between calls; the
+ * dictionary is shared, so words one VM defines are visible to all. Calls
+ * on different VMs may run on different threads at once, but only while
+ * none of them defines words.
+ *
+ * Errors never exit() the host. A word that fails its check, or an
+ * unknown word in rf_eval(), abandons the call, which returns -1 with the
+ * VM's stack as it was before the call, minus any arguments, and forgets
+ * any definition the call left unfinished.
+ */
+
+#ifndef REFORTH_H
+#define REFORTH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct rf_vm rf_vm;
+
+// A host primitive. It takes arguments with rf_pop() and leaves results
+// with rf_push(), on the VM that called it
+typedef void (*rf_host)(rf_vm *vm);
+
+rf_vm* rf_vm_new(void);
+void rf_vm_free(rf_vm *vm);
+
+// Interpret source text. Returns 0, or -1 on an unknown word or failure
+int rf_eval(rf_vm *vm, const char *src);
+
+// Execute a word by name. Returns 0, or -1 if not found or on failure
+int rf_call(rf_vm *vm, const char *name);
+
+void rf_push(rf_vm *vm, long n);
+long rf_pop(rf_vm *vm);
+int rf_depth(rf_vm *vm);
+
+// Add a word that calls fn. Returns 0, or -1 when out of tokens
+int rf_define(const char *name, rf_host fn);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -69,7 +69,16 @@
 		end ;
 
 	: smooth ( -- )
-		x for
+
+		static locals
+			0 value tmp
+		end
+
+		: ttile ( x y -- a )
+			x * + tmp + ;
+
+		\ columns are independent, reading buff and writing tmp
+		: column ( -- )
 			i my!
 			y for 0
 				my 1- i 1- tile c@ +
@@ -81,9 +90,13 @@
 				my 1+ i 1- tile c@ +
 				my 1+ i    tile c@ +
 				my 1+ i 1+ tile c@ +
-				9 / my i tile c!
-			end
-		end ;
+				9 / my i ttile c!
+			end ;
+
+		x y * allocate to tmp
+		x 'column pfor
+		tmp buff x y * cmove
+		tmp free ;
 
 	: zoom ( -- )
 
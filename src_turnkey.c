@@ -0,0 +1,131 @@
+const char src_turnkey[] = {
+  0x5c, 0x20, 0x52, 0x65, 0x66, 0x6f, 0x72, 0x74, 0x68, 0x20, 0x48, 0x54,
+  0x54, 0x50, 0x20, 0x6c, 0x6f, 0x61, 0x64, 0x20, 0x67, 0x65, 0x6e, 0x65,
+  0x72, 0x61, 0x74, 0x6f, 0x72, 0x0a, 0x5c, 0x0a, 0x5c, 0x09, 0x50, 0x4f,
+  0x52, 0x54, 0x3d, 0x38, 0x30, 0x38, 0x30, 0x20, 0x43, 0x4f, 0x4e, 0x4e,
+  0x53, 0x3d, 0x38, 0x20, 0x52, 0x45, 0x51, 0x55, 0x45, 0x53, 0x54, 0x53,
+  0x3d, 0x31, 0x30, 0x30, 0x30, 0x30, 0x20, 0x50, 0x41, 0x54, 0x48, 0x53,
+  0x3d, 0x22, 0x2f, 0x20, 0x2f, 0x68, 0x65, 0x6c, 0x6c, 0x6f, 0x2f, 0x78,
+  0x22, 0x20, 0x2e, 0x2f, 0x77, 0x65, 0x62, 0x6c, 0x6f, 0x61, 0x64, 0x0a,
+  0x5c, 0x0a, 0x5c, 0x20, 0x53, 0x65, 0x6e, 0x64, 0x73, 0x20, 0x47, 0x45,
+  0x54, 0x20, 0x72, 0x65, 0x71, 0x75, 0x65, 0x73, 0x74, 0x73, 0x20, 0x66,
+  0x6f, 0x72, 0x20, 0x50, 0x41, 0x54, 0x48, 0x53, 0x2c, 0x20, 0x72, 0x6f,
+  0x75, 0x6e, 0x64, 0x20, 0x72, 0x6f, 0x62, 0x69, 0x6e, 0x2c, 0x20, 0x6f,
+  0x76, 0x65, 0x72, 0x20, 0x43, 0x4f, 0x4e, 0x4e, 0x53, 0x20, 0x6b, 0x65,
+  0x65, 0x70, 0x2d, 0x61, 0x6c, 0x69, 0x76, 0x65, 0x0a, 0x5c, 0x20, 0x63,
+  0x6f, 0x6e, 0x6e, 0x65, 0x63, 0x74, 0x69, 0x6f, 0x6e, 0x73, 0x20, 0x74,
+  0x6f, 0x20, 0x61, 0x20, 0x73, 0x65, 0x72, 0x76, 0x65, 0x72, 0x20, 0x6f,
+  0x6e, 0x20, 0x74, 0x68, 0x69, 0x73, 0x20, 0x6d, 0x61, 0x63, 0x68, 0x69,
+  0x6e, 0x65, 0x2c, 0x20, 0x74, 0x68, 0x65, 0x6e, 0x20, 0x72, 0x65, 0x70,
+  0x6f, 0x72, 0x74, 0x73, 0x20, 0x74, 0x68, 0x72, 0x6f, 0x75, 0x67, 0x68,
+  0x70, 0x75, 0x74, 0x20, 0x61, 0x6e, 0x64, 0x0a, 0x5c, 0x20, 0x6c, 0x61,
+  0x74, 0x65, 0x6e, 0x63, 0x79, 0x20, 0x61, 0x73, 0x20, 0x74, 0x65, 0x78,
+  0x74, 0x20, 0x6f, 0x6e, 0x20, 0x73, 0x74, 0x64, 0x65, 0x72, 0x72, 0x20,
+  0x61, 0x6e, 0x64, 0x20, 0x61, 0x73, 0x20, 0x4a, 0x53, 0x4f, 0x4e, 0x20,
+  0x6f, 0x6e, 0x20, 0x73, 0x74, 0x64, 0x6f, 0x75, 0x74, 0x2e, 0x0a, 0x0a,
+  0x3a, 0x20, 0x65, 0x6e, 0x76, 0x20, 0x28, 0x20, 0x64, 0x65, 0x66, 0x61,
+  0x75, 0x6c, 0x74, 0x20, 0x6e, 0x61, 0x6d, 0x65, 0x20, 0x2d, 0x2d, 0x20,
+  0x6e, 0x20, 0x29, 0x0a, 0x09, 0x67, 0x65, 0x74, 0x65, 0x6e, 0x76, 0x20,
+  0x64, 0x75, 0x70, 0x20, 0x69, 0x66, 0x20, 0x6e, 0x69, 0x70, 0x20, 0x6e,
+  0x75, 0x6d, 0x62, 0x65, 0x72, 0x20, 0x64, 0x72, 0x6f, 0x70, 0x20, 0x65,
+  0x6c, 0x73, 0x65, 0x20, 0x64, 0x72, 0x6f, 0x70, 0x20, 0x65, 0x6e, 0x64,
+  0x20, 0x3b, 0x0a, 0x0a, 0x30, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x20,
+  0x73, 0x74, 0x61, 0x74, 0x73, 0x0a, 0x0a, 0x3a, 0x20, 0x73, 0x74, 0x61,
+  0x74, 0x20, 0x28, 0x20, 0x69, 0x20, 0x2d, 0x2d, 0x20, 0x6e, 0x20, 0x29,
+  0x0a, 0x09, 0x63, 0x65, 0x6c, 0x6c, 0x73, 0x20, 0x73, 0x74, 0x61, 0x74,
+  0x73, 0x20, 0x2b, 0x20, 0x40, 0x20, 0x3b, 0x0a, 0x0a, 0x38, 0x30, 0x38,
+  0x30, 0x20, 0x20, 0x22, 0x50, 0x4f, 0x52, 0x54, 0x22, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x65, 0x6e, 0x76, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x20,
+  0x70, 0x6f, 0x72, 0x74, 0x0a, 0x38, 0x20, 0x20, 0x20, 0x20, 0x20, 0x22,
+  0x43, 0x4f, 0x4e, 0x4e, 0x53, 0x22, 0x20, 0x20, 0x20, 0x20, 0x65, 0x6e,
+  0x76, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x20, 0x63, 0x6f, 0x6e, 0x6e,
+  0x73, 0x0a, 0x31, 0x30, 0x30, 0x30, 0x30, 0x20, 0x22, 0x52, 0x45, 0x51,
+  0x55, 0x45, 0x53, 0x54, 0x53, 0x22, 0x20, 0x65, 0x6e, 0x76, 0x20, 0x76,
+  0x61, 0x6c, 0x75, 0x65, 0x20, 0x72, 0x65, 0x71, 0x75, 0x65, 0x73, 0x74,
+  0x73, 0x0a, 0x0a, 0x22, 0x50, 0x41, 0x54, 0x48, 0x53, 0x22, 0x20, 0x67,
+  0x65, 0x74, 0x65, 0x6e, 0x76, 0x20, 0x64, 0x75, 0x70, 0x20, 0x30, 0x3d,
+  0x20, 0x69, 0x66, 0x20, 0x64, 0x72, 0x6f, 0x70, 0x20, 0x22, 0x2f, 0x22,
+  0x20, 0x65, 0x6e, 0x64, 0x20, 0x76, 0x61, 0x6c, 0x75, 0x65, 0x20, 0x70,
+  0x61, 0x74, 0x68, 0x73, 0x0a, 0x0a, 0x70, 0x61, 0x74, 0x68, 0x73, 0x20,
+  0x63, 0x6f, 0x6e, 0x6e, 0x73, 0x20, 0x72, 0x65, 0x71, 0x75, 0x65, 0x73,
+  0x74, 0x73, 0x20, 0x70, 0x6f, 0x72, 0x74, 0x20, 0x68, 0x74, 0x74, 0x70,
+  0x2d, 0x6c, 0x6f, 0x61, 0x64, 0x20, 0x74, 0x6f, 0x20, 0x73, 0x74, 0x61,
+  0x74, 0x73, 0x0a, 0x0a, 0x3a, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x6c, 0x65,
+  0x74, 0x65, 0x64, 0x20, 0x28, 0x20, 0x2d, 0x2d, 0x20, 0x6e, 0x20, 0x29,
+  0x20, 0x30, 0x20, 0x73, 0x74, 0x61, 0x74, 0x20, 0x3b, 0x0a, 0x3a, 0x20,
+  0x65, 0x72, 0x72, 0x6f, 0x72, 0x73, 0x20, 0x20, 0x20, 0x20, 0x28, 0x20,
+  0x2d, 0x2d, 0x20, 0x6e, 0x20, 0x29, 0x20, 0x31, 0x20, 0x73, 0x74, 0x61,
+  0x74, 0x20, 0x3b, 0x0a, 0x3a, 0x20, 0x65, 0x6c, 0x61, 0x70, 0x73, 0x65,
+  0x64, 0x20, 0x20, 0x20, 0x28, 0x20, 0x2d, 0x2d, 0x20, 0x6e, 0x20, 0x29,
+  0x20, 0x32, 0x20, 0x73, 0x74, 0x61, 0x74, 0x20, 0x31, 0x20, 0x6d, 0x61,
+  0x78, 0x20, 0x3b, 0x0a, 0x3a, 0x20, 0x70, 0x35, 0x30, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x28, 0x20, 0x2d, 0x2d, 0x20, 0x6e, 0x20, 0x29,
+  0x20, 0x33, 0x20, 0x73, 0x74, 0x61, 0x74, 0x20, 0x3b, 0x0a, 0x3a, 0x20,
+  0x70, 0x39, 0x30, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x28, 0x20,
+  0x2d, 0x2d, 0x20, 0x6e, 0x20, 0x29, 0x20, 0x34, 0x20, 0x73, 0x74, 0x61,
+  0x74, 0x20, 0x3b, 0x0a, 0x3a, 0x20, 0x70, 0x39, 0x39, 0x20, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x28, 0x20, 0x2d, 0x2d, 0x20, 0x6e, 0x20, 0x29,
+  0x20, 0x35, 0x20, 0x73, 0x74, 0x61, 0x74, 0x20, 0x3b, 0x0a, 0x3a, 0x20,
+  0x6c, 0x6f, 0x6e, 0x67, 0x65, 0x73, 0x74, 0x20, 0x20, 0x20, 0x28, 0x20,
+  0x2d, 0x2d, 0x20, 0x6e, 0x20, 0x29, 0x20, 0x36, 0x20, 0x73, 0x74, 0x61,
+  0x74, 0x20, 0x3b, 0x0a, 0x3a, 0x20, 0x6d, 0x65, 0x61, 0x6e, 0x20, 0x20,
+  0x20, 0x20, 0x20, 0x20, 0x28, 0x20, 0x2d, 0x2d, 0x20, 0x6e, 0x20, 0x29,
+  0x20, 0x37, 0x20, 0x73, 0x74, 0x61, 0x74, 0x20, 0x3b, 0x0a, 0x0a, 0x5c,
+  0x20, 0x72, 0x65, 0x73, 0x70, 0x6f, 0x6e, 0x73, 0x65, 0x73, 0x20, 0x70,
+  0x65, 0x72, 0x20, 0x73, 0x65, 0x63, 0x6f, 0x6e, 0x64, 0x0a, 0x3a, 0x20,
+  0x72, 0x61, 0x74, 0x65, 0x20, 0x28, 0x20, 0x2d, 0x2d, 0x20, 0x6e, 0x20,
+  0x29, 0x0a, 0x09, 0x63, 0x6f, 0x6d, 0x70, 0x6c, 0x65, 0x74, 0x65, 0x64,
+  0x20, 0x31, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x20, 0x2a, 0x20, 0x65,
+  0x6c, 0x61, 0x70, 0x73, 0x65, 0x64, 0x20, 0x2f, 0x20, 0x3b, 0x0a, 0x0a,
+  0x5c, 0x20, 0x72, 0x65, 0x73, 0x70, 0x6f, 0x6e, 0x73, 0x65, 0x73, 0x20,
+  0x70, 0x65, 0x72, 0x20, 0x6c, 0x6f, 0x67, 0x32, 0x20, 0x6c, 0x61, 0x74,
+  0x65, 0x6e, 0x63, 0x79, 0x20, 0x62, 0x75, 0x63, 0x6b, 0x65, 0x74, 0x0a,
+  0x3a, 0x20, 0x68, 0x69, 0x73, 0x74, 0x6f, 0x67, 0x72, 0x61, 0x6d, 0x20,
+  0x28, 0x20, 0x2d, 0x2d, 0x20, 0x29, 0x0a, 0x09, 0x33, 0x32, 0x20, 0x66,
+  0x6f, 0x72, 0x0a, 0x09, 0x09, 0x69, 0x20, 0x38, 0x20, 0x2b, 0x20, 0x73,
+  0x74, 0x61, 0x74, 0x20, 0x64, 0x75, 0x70, 0x0a, 0x09, 0x09, 0x69, 0x66,
+  0x09, 0x31, 0x20, 0x69, 0x20, 0x73, 0x68, 0x6c, 0x20, 0x22, 0x20, 0x20,
+  0x20, 0x20, 0x3c, 0x20, 0x25, 0x38, 0x64, 0x20, 0x75, 0x73, 0x20, 0x20,
+  0x25, 0x64, 0x5c, 0x6e, 0x22, 0x20, 0x66, 0x6f, 0x72, 0x6d, 0x61, 0x74,
+  0x20, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x0a, 0x09, 0x09, 0x65, 0x6c, 0x73,
+  0x65, 0x09, 0x64, 0x72, 0x6f, 0x70, 0x0a, 0x09, 0x09, 0x65, 0x6e, 0x64,
+  0x0a, 0x09, 0x65, 0x6e, 0x64, 0x20, 0x3b, 0x0a, 0x0a, 0x72, 0x65, 0x71,
+  0x75, 0x65, 0x73, 0x74, 0x73, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x6c, 0x65,
+  0x74, 0x65, 0x64, 0x20, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x73, 0x20, 0x65,
+  0x6c, 0x61, 0x70, 0x73, 0x65, 0x64, 0x20, 0x31, 0x30, 0x30, 0x30, 0x20,
+  0x2f, 0x0a, 0x22, 0x25, 0x64, 0x20, 0x6d, 0x73, 0x2c, 0x20, 0x25, 0x64,
+  0x20, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x73, 0x2c, 0x20, 0x25, 0x64, 0x2f,
+  0x25, 0x64, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x6c, 0x65, 0x74, 0x65, 0x64,
+  0x5c, 0x6e, 0x22, 0x20, 0x66, 0x6f, 0x72, 0x6d, 0x61, 0x74, 0x20, 0x65,
+  0x72, 0x72, 0x6f, 0x72, 0x0a, 0x72, 0x61, 0x74, 0x65, 0x20, 0x22, 0x25,
+  0x64, 0x20, 0x72, 0x65, 0x71, 0x2f, 0x73, 0x65, 0x63, 0x5c, 0x6e, 0x22,
+  0x20, 0x66, 0x6f, 0x72, 0x6d, 0x61, 0x74, 0x20, 0x65, 0x72, 0x72, 0x6f,
+  0x72, 0x0a, 0x6c, 0x6f, 0x6e, 0x67, 0x65, 0x73, 0x74, 0x20, 0x70, 0x39,
+  0x39, 0x20, 0x70, 0x39, 0x30, 0x20, 0x70, 0x35, 0x30, 0x20, 0x6d, 0x65,
+  0x61, 0x6e, 0x0a, 0x22, 0x6c, 0x61, 0x74, 0x65, 0x6e, 0x63, 0x79, 0x20,
+  0x75, 0x73, 0x65, 0x63, 0x3a, 0x20, 0x6d, 0x65, 0x61, 0x6e, 0x20, 0x25,
+  0x64, 0x20, 0x70, 0x35, 0x30, 0x20, 0x25, 0x64, 0x20, 0x70, 0x39, 0x30,
+  0x20, 0x25, 0x64, 0x20, 0x70, 0x39, 0x39, 0x20, 0x25, 0x64, 0x20, 0x6d,
+  0x61, 0x78, 0x20, 0x25, 0x64, 0x5c, 0x6e, 0x22, 0x20, 0x66, 0x6f, 0x72,
+  0x6d, 0x61, 0x74, 0x20, 0x65, 0x72, 0x72, 0x6f, 0x72, 0x0a, 0x68, 0x69,
+  0x73, 0x74, 0x6f, 0x67, 0x72, 0x61, 0x6d, 0x0a, 0x0a, 0x6c, 0x6f, 0x6e,
+  0x67, 0x65, 0x73, 0x74, 0x20, 0x70, 0x39, 0x39, 0x20, 0x70, 0x39, 0x30,
+  0x20, 0x70, 0x35, 0x30, 0x20, 0x6d, 0x65, 0x61, 0x6e, 0x20, 0x72, 0x61,
+  0x74, 0x65, 0x20, 0x65, 0x6c, 0x61, 0x70, 0x73, 0x65, 0x64, 0x20, 0x65,
+  0x72, 0x72, 0x6f, 0x72, 0x73, 0x20, 0x63, 0x6f, 0x6d, 0x70, 0x6c, 0x65,
+  0x74, 0x65, 0x64, 0x20, 0x63, 0x6f, 0x6e, 0x6e, 0x73, 0x0a, 0x22, 0x7b,
+  0x5c, 0x22, 0x63, 0x6f, 0x6e, 0x6e, 0x73, 0x5c, 0x22, 0x3a, 0x25, 0x64,
+  0x2c, 0x5c, 0x22, 0x63, 0x6f, 0x6d, 0x70, 0x6c, 0x65, 0x74, 0x65, 0x64,
+  0x5c, 0x22, 0x3a, 0x25, 0x64, 0x2c, 0x5c, 0x22, 0x65, 0x72, 0x72, 0x6f,
+  0x72, 0x73, 0x5c, 0x22, 0x3a, 0x25, 0x64, 0x2c, 0x5c, 0x22, 0x65, 0x6c,
+  0x61, 0x70, 0x73, 0x65, 0x64, 0x5f, 0x75, 0x73, 0x5c, 0x22, 0x3a, 0x25,
+  0x64, 0x2c, 0x5c, 0x22, 0x72, 0x70, 0x73, 0x5c, 0x22, 0x3a, 0x25, 0x64,
+  0x2c, 0x5c, 0x22, 0x6d, 0x65, 0x61, 0x6e, 0x5f, 0x75, 0x73, 0x5c, 0x22,
+  0x3a, 0x25, 0x64, 0x2c, 0x5c, 0x22, 0x70, 0x35, 0x30, 0x5f, 0x75, 0x73,
+  0x5c, 0x22, 0x3a, 0x25, 0x64, 0x2c, 0x5c, 0x22, 0x70, 0x39, 0x30, 0x5f,
+  0x75, 0x73, 0x5c, 0x22, 0x3a, 0x25, 0x64, 0x2c, 0x5c, 0x22, 0x70, 0x39,
+  0x39, 0x5f, 0x75, 0x73, 0x5c, 0x22, 0x3a, 0x25, 0x64, 0x2c, 0x5c, 0x22,
+  0x6d, 0x61, 0x78, 0x5f, 0x75, 0x73, 0x5c, 0x22, 0x3a, 0x25, 0x64, 0x7d,
+  0x5c, 0x6e, 0x22, 0x0a, 0x66, 0x6f, 0x72, 0x6d, 0x61, 0x74, 0x20, 0x74,
+  0x79, 0x70, 0x65, 0x0a
+,0};
@@ -12,9 +12,17 @@
 
 1000 value BUFFER
 
-\ format and write to stderr
+\ timestamped lines to stderr, batched; LOG_LEVEL=3 includes request headers
 : log ( ... pattern -- )
-	time "%c " date error format error "\n" error ;
+	2 log-line ;
+
+: debug ( ... pattern -- )
+	3 log-line ;
+
+"LOG_LEVEL" getenv dup
+if	number drop log-level !
+else	drop
+end
 
 : match? ( a p -- f )
 	match nip ;
@@ -22,101 +30,210 @@
 : within? ( a b n -- f )
 	my! - my 1- < ;
 
-\ read a line from stdin
-: read_line ( -- a )
+\ read the request head from stdin, up to and including the blank line.
+\ read-line drops the tail of an over-long line, and lines that no
+\ longer fit are skipped
+: read_request ( -- a n )
 
 	static locals
+		BUFFER 8 * value LIMIT
+		LIMIT buffer head
 		BUFFER buffer line
 	end
 
-	0 line BUFFER 0 cfill
-
-	BUFFER 1-
-	for key my!
-		my \r = if key my! end
-		my \n = until
-		my while
-		my i line c!
-	end
+	0 my!
+	begin
+		0 line BUFFER read-line
+		over and while
+		0 line "request: %s" debug
+		dup my + 2 + LIMIT <
+		if	0 line my head 2 pick cmove
+			my + my!
+			\n my head c!
+			my 1+ my!
+		else	drop
+		end
+	end drop
 
-	begin my while my \n <> while
-		key my!
-	end
+	\n my head c!
+	0 my 1+ head c!
+	0 head my 1+ ;
 
-	0 line ;
+0 value request
 
 \ read and process client headers
 : read_headers ( -- )
 
-	begin
-		read_line dup at! c@ while
-		at "request: %s" log
-
-		at "^GET [^ ]+ HTTP/1" match?
-		if	HTTP_GET to http_method
-			at 4 + dup " " split drop drop
-			here to request_uri place, next
-		end
-
-		at "^User-Agent: .+" match?
-		if	at 12 +
-			here to user_agent place, next
-		end
-	end ;
-
-\ parser hook for HTML tag literals
-: pre_eval ( -- f )
+	request free
+	read_request parse-request to request
+
+	request req-method drop at!
+	0 to http_method
+	at "GET"    0 compare 0= if HTTP_GET    to http_method end
+	at "HEAD"   0 compare 0= if HTTP_HEAD   to http_method end
+	at "PUT"    0 compare 0= if HTTP_PUT    to http_method end
+	at "POST"   0 compare 0= if HTTP_POST   to http_method end
+	at "DELETE" 0 compare 0= if HTTP_DELETE to http_method end
+
+	\ slices into the request buffer; nothing is copied
+	request req-path drop to request_uri
+	"User-Agent" request req-header drop to user_agent ;
+
+macro
+
+\ Compile a page of mixed HTML and Forth into a single word, ahead of time:
+\
+\	html: name
+\	<ul> #{ 3 for } <li>${ i "%d" format }</li> #{ end } </ul>
+\	;html
+\
+\ HTML is compiled as string literals written with TYPE. ${ code } must
+\ leave a string, which is written HTML-escaped. #{ code } is compiled as
+\ ordinary Forth, so control structures may span runs of HTML. Code ends
+\ at the first } outside a string or character literal, and may be at
+\ most CHUNK-1 bytes.
+: html: ( -- )
 
 	static locals
-		BUFFER buffer item
+		4096 value CHUNK
+		CHUNK buffer chunk
+		0 value start
+		0 value stop
+		0 value escaped
 	end
 
-	0 item BUFFER 0 cfill
-
-	sys:source @ dup at!
-	"^<[/!]?[a-zA-Z]+[^>]*>" match? dup
-	if	BUFFER 1-
-		for	c@+ my!
-			my while
-			my i item c!
-			my `> = until
-		end
-		at sys:source !
-		0 item sys:mode @
-		if	string, 'print word,
-		else print
+	\ compile n bytes at a as string literals
+	: literal ( a n -- )
+		begin dup 0> while
+			dup CHUNK 1- min my!
+			over 0 chunk my cmove
+			0 my chunk c!
+			0 chunk string, 'type word,
+			my - swap my + swap
+		end 2drop ;
+
+	\ compile n bytes at a as Forth
+	: code ( a n -- )
+		dup CHUNK <
+		if	my!
+		else	CHUNK 1- "html: embedded code longer than %d bytes\n" format error 1 die
 		end
-	end ;
-
-'pre_eval sys:on-eval !
-
-read_headers
-
-http_method HTTP_GET <>
-request_uri "/" match? 0= or
-if	request_uri "404 %s" log
-	"HTTP/1.1 404 Not Found\n" type
-	"Connection: close\n" type
-	\n emit bye
-end
-
-request_uri "200 %s" log
-"HTTP/1.1 200 OK\n" type
-"Connection: close\n" type
-"Content-type: text/html\n" type
-\n emit
-
+		0 chunk my cmove
+		0 my chunk c!
+		0 chunk evaluate drop ;
+
+	\ find the } ending embedded code, passing over any inside
+	\ "string" or `} literals
+	: close ( a -- a' )
+		0 my!
+		begin dup c@ while
+			dup c@ my
+			if	dup `\ = if drop 1+ else `" = if 0 my! end end
+			else
+				dup `` = if drop 1+ else
+				dup `" = if drop -1 my! else
+				`} = if leave end end end
+			end
+			1+
+		end ;
+
+	: scan ( -- )
+		begin
+			sys:source @ to start
+			start "[$][{]|#[{]|;html([[:space:]]|$)" match my! to stop
+			start stop over - literal
+
+			my 0=
+			if	stop sys:source !
+				leave
+			end
+
+			stop c@ `; =
+			if	stop 5 + sys:source !
+				leave
+			end
+
+			stop c@ `$ = to escaped
+			stop 2 + to start
+			start close to stop
+			start stop over - code
+			escaped if 'type-html word, end
+
+			stop dup c@ if 1+ end sys:source !
+		end ;
+
+	': execute scan '; execute ;
+
+normal
+
+html: index
 <!DOCTYPE html>
 <html>
 <head>
-	<title> "reforth" type </title>
+	<title>${ "reforth" }</title>
 </head>
 <body>
+	<pre>#{ .s }</pre>
+</body>
+</html>
+;html
 
-
-	<pre>
-	.s
-	</pre>
-
+html: hello
+<!DOCTYPE html>
+<html>
+<body>
+	<p>Hello, ${ "name" route-param }!</p>
 </body>
 </html>
+;html
+
+: ok ( -- )
+	request_uri "200 %s" log
+	"HTTP/1.1 200 OK\n" type
+	"Content-type: text/html\n" type
+	\n emit ;
+
+: home ( -- )
+	\ under serve, repeat requests within a minute skip the handler
+	60 cache-page
+	ok index ;
+
+: greet ( -- )
+	ok hello ;
+
+"/"            'home  route
+"/hello/:name" 'greet route
+
+\ handle one request from stdin, writing the response to stdout
+: page ( -- )
+
+	read_headers
+
+	\ parse-request leaves 0 for a malformed request
+	request 0=
+	if	"400 bad request" log
+		"HTTP/1.1 400 Bad Request\n" type
+		\n emit
+		exit
+	end
+
+	http_method HTTP_GET =
+	if	request_uri dispatch
+		if exit end
+	end
+
+	request_uri "404 %s" log
+	"HTTP/1.1 404 Not Found\n" type
+	\n emit ;
+
+\ With PORT set, serve requests from one warm process, or from WORKERS
+\ forked processes; otherwise handle a single request on stdin (eg, under
+\ socat or inetd).
+"PORT" getenv dup
+if	number drop
+	"WORKERS" getenv dup
+	if	number drop 'page serve-prefork
+	else	drop 'page serve
+	end
+else	drop page
+end
@@ -1,2 +1,8 @@
 #!/bin/sh
-socat TCP4-LISTEN:8080,fork EXEC:./web
+# Serve web.fs from one warm process, or WORKERS=n preforked processes.
+# SOCAT=1 uses the old setup, which forks and execs ./web per connection.
+if [ -n "$SOCAT" ]; then
+	socat TCP4-LISTEN:8080,fork EXEC:./web
+else
+	PORT=8080 exec ./web
+fi